@@ -1,6 +1,7 @@
 #include "config_file.h"
 
 #include <cassert>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <mutex>
@@ -10,6 +11,13 @@
 
 
 const int kDefaultEyesDistance = 66;  //!< Расстояние между окулярами в шлеме
+const double kDefaultTiltGain = 0.5;  //!< Скорость коррекции наклона, 1/с
+const double kDefaultAccelTolerance = 0.1;  //!< Допуск модуля ускорения, g
+const double kDefaultMinCutoff = 3.0;  //!< Частота среза сглаживания, Гц
+const double kDefaultCutoffBeta = 0.3;  //!< Прирост частоты среза, Гц*с/град
+const double kDefaultSpeedCutoff = 10.0;  //!< Частота среза модуля скорости, Гц
+const int64_t kFixedPointFactor =
+    1000000000L;  //!< Множитель для хранения дрейфа в целых числах
 
 std::mutex g_ConfigLock;
 
@@ -143,6 +151,207 @@ void Config::GetOptions(std::string* screen, int* eyes_distance,
   }
 }
 
+void Config::GetFusionOptions(double* tilt_gain, double* accel_tolerance,
+    bool* bias_tracking, bool* save_bias) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (tilt_gain) {
+    *tilt_gain = kDefaultTiltGain;
+  }
+  if (accel_tolerance) {
+    *accel_tolerance = kDefaultAccelTolerance;
+  }
+  if (bias_tracking) {
+    *bias_tracking = true;
+  }
+  if (save_bias) {
+    *save_bias = false;
+  }
+
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (dict) {
+    if (tilt_gain) {
+      *tilt_gain =
+          iniparser_getdouble(dict, "Fusion:tilt_gain", kDefaultTiltGain);
+    }
+    if (accel_tolerance) {
+      *accel_tolerance = iniparser_getdouble(
+          dict, "Fusion:accel_tolerance", kDefaultAccelTolerance);
+    }
+    if (bias_tracking) {
+      *bias_tracking = iniparser_getint(dict, "Fusion:bias_tracking", 1) != 0;
+    }
+    if (save_bias) {
+      *save_bias = iniparser_getint(dict, "Fusion:save_bias", 0) != 0;
+    }
+    iniparser_freedict(dict);
+  }
+}
+
+
+void Config::GetSmoothingOptions(
+    double* min_cutoff, double* beta, double* speed_cutoff) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (min_cutoff) {
+    *min_cutoff = kDefaultMinCutoff;
+  }
+  if (beta) {
+    *beta = kDefaultCutoffBeta;
+  }
+  if (speed_cutoff) {
+    *speed_cutoff = kDefaultSpeedCutoff;
+  }
+
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (dict) {
+    if (min_cutoff) {
+      *min_cutoff = iniparser_getdouble(
+          dict, "Fusion:smooth_min_cutoff", kDefaultMinCutoff);
+    }
+    if (beta) {
+      *beta =
+          iniparser_getdouble(dict, "Fusion:smooth_beta", kDefaultCutoffBeta);
+    }
+    if (speed_cutoff) {
+      *speed_cutoff = iniparser_getdouble(
+          dict, "Fusion:smooth_speed_cutoff", kDefaultSpeedCutoff);
+    }
+    iniparser_freedict(dict);
+  }
+}
+
+
+void Config::GetThreadOptions(
+    const std::string& role, std::string* cpus, int* fifo, int* nice) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (cpus) {
+    cpus->clear();
+  }
+  if (fifo) {
+    *fifo = 0;
+  }
+  if (nice) {
+    *nice = 0;
+  }
+
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (dict) {
+    auto key = "Threads:" + role;
+    if (cpus) {
+      *cpus = iniparser_getstring(dict, (key + "_cpus").c_str(), "");
+    }
+    if (fifo) {
+      *fifo = iniparser_getint(dict, (key + "_fifo").c_str(), 0);
+    }
+    if (nice) {
+      *nice = iniparser_getint(dict, (key + "_nice").c_str(), 0);
+    }
+    iniparser_freedict(dict);
+  }
+}
+
+
+void Config::GetPowerOptions(bool* pause_when_removed) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (pause_when_removed) {
+    *pause_when_removed = true;
+  }
+
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (dict) {
+    if (pause_when_removed) {
+      *pause_when_removed =
+          iniparser_getint(dict, "Power:pause_when_removed", 1) != 0;
+    }
+    iniparser_freedict(dict);
+  }
+}
+
+
+void Config::GetMetricsOptions(int* period) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (period) {
+    *period = 0;
+  }
+
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (dict) {
+    if (period) {
+      *period = iniparser_getint(dict, "Metrics:period", 0);
+    }
+    iniparser_freedict(dict);
+  }
+}
+
+
+bool Config::SetCalibration(double right, double top, double clock,
+    int64_t samples, const double* variances) {
+  std::lock_guard<std::mutex> lk(g_ConfigLock);
+
+  if (!CreateConfigFileIfNotExist(false)) {
+    return false;
+  }
+  auto fname = GetConfigFileName();
+  auto dict = iniparser_load(fname.c_str());
+  if (!dict) {
+    std::cerr << "Can't parse configuration file" << std::endl;
+    return false;
+  }
+
+  bool res = true;
+  auto str = std::to_string(int64_t(right * kFixedPointFactor));
+  auto stt = std::to_string(int64_t(top * kFixedPointFactor));
+  auto stc = std::to_string(int64_t(clock * kFixedPointFactor));
+  res = res && (iniparser_set(dict, "Calibration", nullptr) == 0);
+  res = res && (iniparser_set(dict, "Calibration:right", str.c_str()) == 0);
+  res = res && (iniparser_set(dict, "Calibration:top", stt.c_str()) == 0);
+  res = res && (iniparser_set(dict, "Calibration:clock", stc.c_str()) == 0);
+  // Статистика прежней калибровки удаляется: она описывает другой дрейф
+  if (samples > 0) {
+    auto sts = std::to_string(samples);
+    res = res && (iniparser_set(dict, "Calibration:samples", sts.c_str()) == 0);
+  } else {
+    iniparser_unset(dict, "Calibration:samples");
+  }
+  const char* keys[] = {"Calibration:right_variance",
+      "Calibration:top_variance", "Calibration:clock_variance"};
+  for (int i = 0; i < 3; ++i) {
+    if (variances) {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%.6e", variances[i]);
+      res = res && (iniparser_set(dict, keys[i], buffer) == 0);
+    } else {
+      iniparser_unset(dict, keys[i]);
+    }
+  }
+  if (!res) {
+    std::cerr << "Can't generate configuration file" << std::endl;
+  } else {
+    auto f = fopen(fname.c_str(), "w+");
+    if (!f) {
+      std::cerr << "Can't open configuration file '" << fname << "'"
+                << std::endl;
+      res = false;
+    } else {
+      iniparser_dump_ini(dict, f);
+      fclose(f);
+    }
+  }
+
+  iniparser_freedict(dict);
+  return res;
+}
+
+
 void Config::ClearOptions() {
   std::lock_guard<std::mutex> lk(g_ConfigLock);
   CreateConfigFileIfNotExist(true);
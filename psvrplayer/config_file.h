@@ -14,6 +14,58 @@ void GetOptions(std::string* screen, int* eyes_distance, bool* swap_color,
 void SetOptions(std::string* screen, int* eyes_distance, bool* swap_color,
     bool* swap_layer, double* rotation);
 
+/*! Получить настройки слияния данных сенсоров. Получить можно только часть.
+Для неважных опций передаётся nullptr. Функция потокобезопасная
+\param tilt_gain скорость подтягивания наклона к вертикали акселерометра, доля
+отклонения в секунду. 0 - коррекция выключена
+\param accel_tolerance допустимое отклонение модуля ускорения от 1 g, при
+котором показания акселерометра ещё используются
+\param bias_tracking уточнять дрейф гироскопа во время просмотра, когда шлем
+неподвижен
+\param save_bias сохранять уточнённый дрейф в конфигурации при завершении */
+void GetFusionOptions(double* tilt_gain, double* accel_tolerance,
+    bool* bias_tracking, bool* save_bias);
+
+/*! Получить настройки сглаживания угловой скорости (фильтр One-Euro).
+Получить можно только часть. Для неважных опций передаётся nullptr. Функция
+потокобезопасная
+\param min_cutoff частота среза в покое, Гц. 0 - сглаживание выключено
+\param beta прирост частоты среза, Гц на градус в секунду
+\param speed_cutoff частота среза для сглаживания модуля скорости, Гц */
+void GetSmoothingOptions(double* min_cutoff, double* beta,
+    double* speed_cutoff);
+
+/*! Получить настройки потока. Получить можно только часть. Для неважных опций
+передаётся nullptr. Функция потокобезопасная
+\param role роль потока (см. SetupThread)
+\param cpus список процессоров для привязки, например "0,2-3". Пустая строка -
+без привязки
+\param fifo приоритет реального времени SCHED_FIFO. 0 - не используется
+\param nice значение nice, если приоритет реального времени не задан или не
+получен */
+void GetThreadOptions(
+    const std::string& role, std::string* cpus, int* fifo, int* nice);
+
+/*! Получить настройки энергосбережения. Функция потокобезопасная
+\param pause_when_removed приостанавливать воспроизведение и отрисовку, пока
+шлем снят */
+void GetPowerOptions(bool* pause_when_removed);
+
+/*! Получить настройки метрик. Функция потокобезопасная
+\param period период вывода сводки метрик в секундах. 0 - сводка выводится
+только по запросу и при завершении */
+void GetMetricsOptions(int* period);
+
+/*! Сохранить дрейф гироскопа (результат калибровки) в конфигурации. Скорости
+в градусах в миллисекунду. Функция потокобезопасная
+\param samples количество измерений, по которым оценён дрейф. 0 - количество
+не сохраняется, а сохранённое прежде удаляется
+\param variances дисперсии скоростей по осям (вправо, вверх, по часовой
+стрелке) или nullptr. При nullptr сохранённые прежде дисперсии удаляются
+\return признак успешного сохранения */
+bool SetCalibration(double right, double top, double clock, int64_t samples,
+    const double* variances);
+
 /*! Получить имена из конфигурационного файла. */
 void GetDevicesName(uint32_t* control_device, uint32_t* sensor_device);
 
@@ -0,0 +1,171 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+FramePacing::FramePacing() { SetRates(0.0, 0); }
+
+
+void FramePacing::SetRates(double frame_rate, int refresh_rate) {
+  if (frame_rate > 0.0 && refresh_rate > 0) {
+    vsyncs_per_frame_ = refresh_rate / frame_rate;
+    refresh_period_ = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / refresh_rate));
+  } else {
+    vsyncs_per_frame_ = 0.0;
+    refresh_period_ = Clock::duration::zero();
+  }
+  vsync_counter_ = 0;
+  has_swap_ = false;
+  render_cost_ = Clock::duration::zero();
+  margin_ = kMinMargin;
+  has_frame_ = false;
+  next_frame_vsync_ = 0.0;
+  cadence_errors_ = 0;
+  dropped_frames_ = 0;
+  missed_vsyncs_ = 0;
+  last_report_ = Clock::now();
+}
+
+
+bool FramePacing::IsEnabled() const { return vsyncs_per_frame_ > 0.0; }
+
+
+FramePacing::Clock::duration FramePacing::GetRefreshPeriod() const {
+  return refresh_period_;
+}
+
+
+void FramePacing::OnSwap(Clock::time_point swap_time) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  int64_t vsyncs = 1;
+  if (has_swap_) {
+    // Количество развёрток с прошлого вывода. Больше одной - пропуск
+    double periods = double((swap_time - last_swap_).count()) /
+                     double(refresh_period_.count());
+    vsyncs = std::max<int64_t>(1, std::llround(periods));
+    missed_vsyncs_ += vsyncs - 1;
+
+    // Вывод буфера завершается не раньше развёртки, поэтому фазу оцениваем
+    // по нижней границе: более раннее время принимаем сразу, более позднее -
+    // с малым весом, чтобы отслеживать дрейф часов
+    auto predicted = vsync_time_ + vsyncs * refresh_period_;
+    auto residual = swap_time - predicted;
+    if (residual < Clock::duration::zero()) {
+      vsync_time_ = swap_time;
+    } else {
+      vsync_time_ = predicted + residual / 16;
+    }
+
+    // Пропуск развёртки - не хватило запаса. Увеличиваем его, а при
+    // стабильном выводе понемногу уменьшаем
+    if (vsyncs > 1) {
+      margin_ = std::min(margin_ * 2, kMaxMargin);
+    } else {
+      margin_ = std::max(margin_ - margin_ / 256, kMinMargin);
+    }
+  } else {
+    vsync_time_ = swap_time;
+  }
+  has_swap_ = true;
+  last_swap_ = swap_time;
+  vsync_counter_ += vsyncs;
+
+  if (swap_time - last_report_ >= kReportInterval) {
+    Report(swap_time);
+  }
+}
+
+
+FramePacing::Clock::time_point FramePacing::GetRenderStart() const {
+  auto now = Clock::now();
+  if (!IsEnabled() || !has_swap_) {
+    return now;
+  }
+  // Ближайшая развёртка, к которой ещё можно успеть. Если срок начала для
+  // неё прошёл, то ждём срока следующей, а не рисуем сразу: иначе кадр
+  // ждал бы развёртки почти период со старым положением шлема
+  auto budget = render_cost_ + margin_;
+  auto start = vsync_time_ + refresh_period_ - budget;
+  while (start < now) {
+    start += refresh_period_;
+  }
+  return start;
+}
+
+
+FramePacing::Clock::time_point FramePacing::GetDisplayTime() const {
+  auto now = Clock::now();
+  if (!IsEnabled() || !has_swap_) {
+    return now;
+  }
+  auto display = vsync_time_ + refresh_period_;
+  while (display < now + render_cost_) {
+    display += refresh_period_;
+  }
+  return display;
+}
+
+
+void FramePacing::OnRenderStart(Clock::time_point time) {
+  render_start_ = time;
+}
+
+
+void FramePacing::OnRenderDone(Clock::time_point time) {
+  // Рост времени отрисовки принимаем сразу, снижение - постепенно
+  auto cost = time - render_start_;
+  if (cost > render_cost_) {
+    render_cost_ = cost;
+  } else {
+    render_cost_ -= (render_cost_ - cost) / 32;
+  }
+}
+
+
+bool FramePacing::IsFrameDue() const {
+  if (!IsEnabled() || !has_frame_) {
+    return true;
+  }
+  return double(vsync_counter_ + 1) >= next_frame_vsync_ - 0.5;
+}
+
+
+void FramePacing::OnFrameShown(size_t dropped) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  dropped_frames_ += dropped;
+  double shown_vsync = double(vsync_counter_ + 1);
+  if (!has_frame_) {
+    has_frame_ = true;
+    next_frame_vsync_ = shown_vsync + vsyncs_per_frame_;
+    return;
+  }
+
+  if (std::abs(shown_vsync - next_frame_vsync_) >= 1.0) {
+    // Кадр пришёл не вовремя: расписание строим заново от текущего кадра
+    ++cadence_errors_;
+    next_frame_vsync_ = shown_vsync;
+  }
+  next_frame_vsync_ += vsyncs_per_frame_;
+}
+
+
+void FramePacing::Report(Clock::time_point now) {
+  if (cadence_errors_ != 0 || dropped_frames_ != 0 || missed_vsyncs_ != 0) {
+    std::cerr << "Frame cadence errors: " << cadence_errors_
+              << ", dropped frames: " << dropped_frames_
+              << ", missed vsyncs: " << missed_vsyncs_ << std::endl;
+  }
+  cadence_errors_ = 0;
+  dropped_frames_ = 0;
+  missed_vsyncs_ = 0;
+  last_report_ = now;
+}
@@ -0,0 +1,91 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <chrono>
+#include <cstdint>
+
+/*! Планирование смены кадров фильма по кадровой развёртке экрана (vsync).
+Каждый кадр фильма должен показываться одинаковое количество развёрток
+(например, 5 развёрток при 24 кадрах/с на 120 Гц). Номер развёртки считается по
+времени завершения вывода буфера (swap) при включённой синхронизации.
+Отклонения от расписания считаются ошибками темпа и периодически пишутся в лог.
+По временам вывода буфера оценивается фаза развёртки, а по замерам - время
+отрисовки сцены. Это позволяет начинать отрисовку непосредственно перед
+развёрткой, чтобы положение шлема было как можно свежее.
+Класс используется только в потоке отрисовки */
+class FramePacing {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  FramePacing();
+
+  /*! Задать частоты кадров и обновления экрана. Расписание сбрасывается.
+  \param frame_rate частота кадров фильма. 0 - планирование выключено
+  \param refresh_rate частота обновления экрана в Гц. 0 - планирование
+  выключено */
+  void SetRates(double frame_rate, int refresh_rate);
+
+  /*! Признак включённого планирования */
+  bool IsEnabled() const;
+
+  /*! Период развёртки экрана */
+  Clock::duration GetRefreshPeriod() const;
+
+  /*! Отметить завершение вывода буфера на экран
+  \param swap_time время возврата из функции вывода буфера */
+  void OnSwap(Clock::time_point swap_time);
+
+  /*! Выдать время, когда нужно начать отрисовку, чтобы успеть к следующей
+  развёртке. Время не раньше текущего: если начинать отрисовку к ближайшей
+  развёртке уже поздно, то выдаётся время начала для следующей. Если фаза
+  развёртки ещё неизвестна, то выдаётся текущее время */
+  Clock::time_point GetRenderStart() const;
+
+  /*! Выдать ожидаемое время показа кадра, отрисовка которого начинается
+  сейчас: ближайшая развёртка, к которой успевает отрисовка. Если фаза
+  развёртки неизвестна, то выдаётся текущее время */
+  Clock::time_point GetDisplayTime() const;
+
+  /*! Отметить начало отрисовки сцены */
+  void OnRenderStart(Clock::time_point time);
+
+  /*! Отметить окончание отрисовки сцены перед выводом буфера */
+  void OnRenderDone(Clock::time_point time);
+
+  /*! Признак, что на следующей развёртке нужно показать новый кадр фильма */
+  bool IsFrameDue() const;
+
+  /*! Отметить, что новый кадр фильма будет показан на следующей развёртке
+  \param dropped количество кадров, пропущенных без показа */
+  void OnFrameShown(size_t dropped);
+
+ private:
+  const Clock::duration kReportInterval =
+      std::chrono::seconds(5);  //!< Интервал вывода ошибок темпа в лог
+  const Clock::duration kMinMargin =
+      std::chrono::microseconds(1500);  //!< Минимальный запас до развёртки
+  const Clock::duration kMaxMargin =
+      std::chrono::milliseconds(6);  //!< Максимальный запас до развёртки
+
+  double vsyncs_per_frame_;  //!< Количество развёрток на кадр фильма
+  Clock::duration refresh_period_;  //!< Период развёртки
+  int64_t vsync_counter_;  //!< Номер последней выведенной развёртки
+  bool has_swap_;  //!< Признак, что был хотя бы один вывод буфера
+  Clock::time_point last_swap_;  //!< Время последнего вывода буфера
+  Clock::time_point vsync_time_;  //!< Оценка времени последней развёртки
+  Clock::time_point render_start_;  //!< Начало текущей отрисовки
+  Clock::duration render_cost_;  //!< Оценка времени отрисовки сцены
+  Clock::duration margin_;  //!< Запас до развёртки на неучтённую работу GPU
+  bool has_frame_;  //!< Признак, что был показан хотя бы один кадр
+  double next_frame_vsync_;  //!< Номер развёртки для следующего кадра
+
+  // Статистика для лога
+  uint64_t cadence_errors_;  //!< Кадры, показанные не по расписанию
+  uint64_t dropped_frames_;  //!< Кадры, пропущенные без показа
+  uint64_t missed_vsyncs_;  //!< Развёртки без вывода буфера
+  Clock::time_point last_report_;  //!< Время последнего вывода в лог
+
+  void Report(Clock::time_point now);
+};
+
+#endif  // FRAME_PACING_H
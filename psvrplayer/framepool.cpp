@@ -2,18 +2,34 @@
 
 #include <cassert>
 #include <iostream>
-#include <mutex>
 #include <vector>
 
+#include "metrics.h"
+#include "profiled_mutex.h"
+
 std::vector<Frame> frame_pool_;
-std::mutex pool_lock_;
+
+/*! Выдать блокировку пула. Блокировка создаётся при первом обращении, после
+создания реестра метрик */
+static ProfiledMutex& PoolLock() {
+  static ProfiledMutex lock("pool");
+  return lock;
+}
+
+/*! Выдать метрику размера пула. Метрика запрашивается при первом обращении,
+после создания реестра */
+static Metrics::Gauge& PoolSizeMetric() {
+  static Metrics::Gauge& gauge = Metrics::GetGauge("frame_pool_size");
+  return gauge;
+}
 
 
 Frame RequestFrame(int align_width, int align_height) {
-  std::lock_guard<std::mutex> lk(pool_lock_);
+  std::lock_guard<ProfiledMutex> lk(PoolLock());
   while (!frame_pool_.empty()) {
     Frame fr = std::move(frame_pool_.back());
     frame_pool_.pop_back();
+    PoolSizeMetric().Set(int64_t(frame_pool_.size()));
     int fr_width, fr_height;
     fr.GetSizes(nullptr, nullptr, &fr_width, &fr_height);
     if (fr_width == align_width && fr_height == align_height) {
@@ -26,9 +42,10 @@ Frame RequestFrame(int align_width, int align_height) {
 
 
 void ReleaseFrame(Frame&& frame) {
-  std::lock_guard<std::mutex> lk(pool_lock_);
+  std::lock_guard<ProfiledMutex> lk(PoolLock());
   frame.SetSize(0, 0);
   frame_pool_.push_back(std::move(frame));
+  PoolSizeMetric().Set(int64_t(frame_pool_.size()));
 }
 
 
@@ -0,0 +1,430 @@
+#include "latency_harness.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Glfw library includes
+#define GLAD_GL_IMPLEMENTATION
+#include "glad/glad.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "framepool.h"
+#include "metrics.h"
+#include "play_screen.h"
+#include "synthetic_video_player.h"
+#include "thread_policy.h"
+#include "trace.h"
+#include "transformer.h"
+#include "video_player.h"
+#include "vr_helmet.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int kScreenWidth = 1920;  //!< Ширина скрытого окна (экран шлема)
+const int kScreenHeight = 1080;  //!< Высота скрытого окна
+const char kMovie[] = "1920x1080:30:sbs";  //!< Описание фильма
+const int kRefreshRate = 60;  //!< Частота обновления экрана, Гц
+const int kTagsAmount =
+    SyntheticVideoPlayer::kColorTags;  //!< Количество номеров кадров
+const std::chrono::milliseconds kEventTimeout{
+    1000};  //!< Время ожидания события на экране, после которого оно потеряно
+const std::chrono::milliseconds kSettleTime{
+    300};  //!< Пауза перед этапом, чтобы отрисовка вошла в обычный темп
+
+
+/*! Выдать время в микросекундах */
+int64_t NowMcs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now().time_since_epoch())
+      .count();
+}
+
+
+/*! Замена экрана: скрытое окно. После каждой отрисовки из буфера считывается
+пиксель в центре левого глаза и передаётся обработчику номер кадра на нём */
+class ProbeScreen: public IPlayScreen {
+ public:
+  /*! Создать окно. При ошибке выбрасывается исключение
+  \param on_present обработчик вывода буфера с номером кадра (-1 - нет
+  изображения). Вызывается в потоке отрисовки */
+  explicit ProbeScreen(std::function<void(int tag)> on_present);
+  virtual ~ProbeScreen();
+
+  void Run() override;
+  void SetKeyboardFilter(
+      std::function<void(int, int, int, int)> fn) override {}
+  void SetMouseEvent(std::function<void(double, double)> fn) override {}
+  void MakeScreenCurrent() override;
+  int SelectRefreshRate(double frame_rate) override { return kRefreshRate; }
+  void DisplayBuffer() override;
+  void GetFrameSize(int& width, int& height) override;
+
+  /*! Завершить Run. Функция вызывается из любого потока */
+  void Stop();
+
+ private:
+  ProbeScreen(const ProbeScreen&) = delete;
+  ProbeScreen(ProbeScreen&&) = delete;
+  ProbeScreen& operator=(const ProbeScreen&) = delete;
+  ProbeScreen& operator=(ProbeScreen&&) = delete;
+
+  GLFWwindow* window_;
+  std::function<void(int tag)> on_present_;  //!< Обработчик вывода буфера
+};
+
+
+ProbeScreen::ProbeScreen(std::function<void(int tag)> on_present)
+    : window_(nullptr), on_present_(on_present) {
+  if (!glfwInit()) {
+    throw std::runtime_error("Can't initialize GLFW library");
+  }
+  glfwDefaultWindowHints();
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  window_ = glfwCreateWindow(
+      kScreenWidth, kScreenHeight, "PS VR Player latency", NULL, NULL);
+  if (!window_) {
+    glfwTerminate();
+    throw std::runtime_error("Can't create hidden window");
+  }
+}
+
+
+ProbeScreen::~ProbeScreen() {
+  glfwDestroyWindow(window_);
+  glfwTerminate();
+}
+
+
+void ProbeScreen::Run() {
+  while (!glfwWindowShouldClose(window_)) {
+    glfwWaitEvents();
+  }
+}
+
+
+void ProbeScreen::MakeScreenCurrent() {
+  glfwMakeContextCurrent(window_);
+  // Темп задаёт расписание трансформатора, а не развёртка сервера дисплея
+  glfwSwapInterval(0);
+}
+
+
+void ProbeScreen::DisplayBuffer() {
+  int width, height;
+  GetFrameSize(width, height);
+  // Чтение дожидается окончания отрисовки буфера
+  uint8_t pixel[4] = {0, 0, 0, 0};
+  glReadPixels(
+      width / 4, height / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  glfwSwapBuffers(window_);
+  on_present_(
+      SyntheticVideoPlayer::DecodeColorTag(pixel[0], pixel[1], pixel[2]));
+}
+
+
+void ProbeScreen::GetFrameSize(int& width, int& height) {
+  glfwGetFramebufferSize(window_, &width, &height);
+}
+
+
+void ProbeScreen::Stop() {
+  glfwSetWindowShouldClose(window_, GLFW_TRUE);
+  glfwPostEmptyEvent();
+}
+
+
+/*! Замена шлема: смотрит вперёд или, по команде, назад. Положение меняется
+скачком, без предсказания */
+class ProbeHelmet: public IHelmet {
+ public:
+  ProbeHelmet() : backward_(false) {}
+
+  void SetVRMode(VRMode mode) override {}
+  void CenterView() override {}
+  void GetViewPoint(glm::mat4& rotation) override {
+    rotation = backward_ ? glm::rotate(glm::mat4(1.0f), glm::radians(180.0f),
+                               glm::vec3(0.0f, 1.0f, 0.0f))
+                         : glm::mat4(1.0f);
+  }
+  void GetViewPointAt(
+      Clock::time_point time, glm::mat4& rotation) override {
+    GetViewPoint(rotation);
+  }
+  void SetRotationSpeedup(double speedup) override {}
+  void SetWornFn(std::function<void(bool worn)> fn) override {
+    if (fn) {
+      fn(true);
+    }
+  }
+
+  /*! Повернуть шлем
+  \param backward признак взгляда назад */
+  void Turn(bool backward) { backward_ = backward; }
+
+ private:
+  std::atomic_bool backward_;  //!< Признак взгляда назад
+};
+
+
+/*! Измерение задержек: управляет этапами и обнаруживает события на экране */
+class LatencyHarness {
+ public:
+  explicit LatencyHarness(int events);
+
+  /*! Провести измерение. Вызывается в основном потоке
+  \return код возврата */
+  int Run();
+
+ private:
+  LatencyHarness(const LatencyHarness&) = delete;
+  LatencyHarness(LatencyHarness&&) = delete;
+  LatencyHarness& operator=(const LatencyHarness&) = delete;
+  LatencyHarness& operator=(LatencyHarness&&) = delete;
+
+  enum class Phase { kIdle, kDecode, kMotion };
+
+  int events_;  //!< Количество событий на этапе
+  std::shared_ptr<ProbeScreen> screen_;
+  std::shared_ptr<ProbeHelmet> helmet_;
+  IVideoPlayerPtr player_;
+  TransformerPtr transformer_;
+  LatencyHistogram& decode_latency_;  //!< Задержки от кадра до экрана
+  LatencyHistogram& motion_latency_;  //!< Задержки от движения до экрана
+
+  std::mutex state_lock_;  //!< Блокировка состояния обнаружения
+  std::condition_variable state_var_;  //!< Событие обнаружения на экране
+  Phase phase_;  //!< Текущий этап
+  std::array<int64_t, kTagsAmount>
+      tag_times_;  //!< Время передачи кадров по номерам, мкс. -1 - кадр уже
+                   //!< обнаружен или не передавался
+  int frames_sent_;  //!< Количество переданных кадров
+  int last_sent_tag_;  //!< Номер последнего переданного кадра. -1 - нет
+  int last_tag_;  //!< Последний обнаруженный номер кадра
+  int decode_detected_;  //!< Количество обнаруженных кадров
+  bool step_pending_;  //!< Признак ожидания поворота на экране
+  bool step_visible_;  //!< Ожидаемый вид после поворота: есть изображение
+  int64_t step_time_;  //!< Время поворота, мкс
+  int motion_detected_;  //!< Количество обнаруженных поворотов
+
+  /*! Обработать вывод буфера. Вызывается в потоке отрисовки
+  \param tag номер кадра на экране. -1 - изображения нет */
+  void OnPresent(int tag);
+
+  /*! Провести этапы измерения. Выполняется в отдельном потоке */
+  void Drive();
+
+  /*! Этап от кадра до экрана: проиграть кадры с номерами */
+  void MeasureDecode();
+
+  /*! Этап от движения до экрана: поворачивать шлем */
+  void MeasureMotion();
+
+  /*! Передать кадр проигрывателя трансформатору, запомнив время передачи.
+  Вызывается в потоке проигрывателя */
+  void OnFrame(Frame&& frame);
+
+  /*! Вывести результаты этапа
+  \param name название этапа
+  \param detected количество обнаруженных событий
+  \param latency гистограмма задержек */
+  void Report(
+      const char* name, int detected, const LatencyHistogram& latency);
+};
+
+
+LatencyHarness::LatencyHarness(int events)
+    : events_(events),
+      decode_latency_(Metrics::GetHistogram("decode_to_photon_us")),
+      motion_latency_(Metrics::GetHistogram("motion_to_photon_us")),
+      phase_(Phase::kIdle),
+      frames_sent_(0),
+      last_sent_tag_(-1),
+      last_tag_(-1),
+      decode_detected_(0),
+      step_pending_(false),
+      step_visible_(true),
+      step_time_(0),
+      motion_detected_(0) {
+  tag_times_.fill(-1);
+}
+
+
+int LatencyHarness::Run() {
+  try {
+    screen_ = std::make_shared<ProbeScreen>(
+        [this](int tag) { OnPresent(tag); });
+  } catch (std::runtime_error& err) {
+    std::cerr << "ERROR: " << err.what() << std::endl;
+    return 1;
+  }
+  helmet_ = std::make_shared<ProbeHelmet>();
+  transformer_ =
+      CreateTransformer(kLeftRight180, kLeftRightStreams, screen_, helmet_);
+  if (!transformer_) {
+    return 1;
+  }
+  player_ = CreateSyntheticVideoPlayer();
+  if (!player_ || !player_->OpenMovie(kMovie)) {
+    return 1;
+  }
+  auto fps = player_->GetFrameRate();
+  transformer_->SetFramePacing(fps, screen_->SelectRefreshRate(fps));
+  player_->SetDisplayFn([this](Frame&& frame) { OnFrame(std::move(frame)); });
+
+  std::thread driver([this]() {
+    Drive();
+    screen_->Stop();
+  });
+  screen_->Run();
+  driver.join();
+
+  player_->SetDisplayFn({});
+  player_->CloseMovie();
+  transformer_.reset();  // Трансформатор держит окно
+  assert(screen_.use_count() == 1);
+
+  Report("Decode to photon", decode_detected_, decode_latency_);
+  Report("Motion to photon", motion_detected_, motion_latency_);
+  return (decode_detected_ > 0 && motion_detected_ > 0) ? 0 : 1;
+}
+
+
+void LatencyHarness::OnPresent(int tag) {
+  auto now = NowMcs();
+  std::lock_guard<std::mutex> lk(state_lock_);
+  switch (phase_) {
+    case Phase::kDecode:
+      if (tag < 0 || tag == last_tag_) {
+        break;
+      }
+      last_tag_ = tag;
+      if (tag_times_[tag] >= 0) {
+        decode_latency_.Add(now - tag_times_[tag]);
+        tag_times_[tag] = -1;
+        ++decode_detected_;
+        state_var_.notify_all();
+      }
+      break;
+    case Phase::kMotion:
+      if (step_pending_ && (tag >= 0) == step_visible_) {
+        motion_latency_.Add(now - step_time_);
+        step_pending_ = false;
+        ++motion_detected_;
+        state_var_.notify_all();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+void LatencyHarness::Drive() {
+  SetupThread("harness");
+  MeasureDecode();
+  MeasureMotion();
+}
+
+
+void LatencyHarness::MeasureDecode() {
+  std::unique_lock<std::mutex> lk(state_lock_);
+  phase_ = Phase::kDecode;
+  lk.unlock();
+
+  player_->Play();
+  lk.lock();
+  auto duration = std::chrono::duration<double>(
+      events_ / player_->GetFrameRate());
+  state_var_.wait_for(lk, duration + kEventTimeout,
+      [this] { return frames_sent_ >= events_; });
+  lk.unlock();
+  player_->Pause(true);
+
+  // Последний кадр должен дойти до экрана
+  lk.lock();
+  state_var_.wait_for(lk, kEventTimeout, [this] {
+    return last_sent_tag_ < 0 || tag_times_[last_sent_tag_] < 0;
+  });
+  phase_ = Phase::kIdle;
+}
+
+
+void LatencyHarness::MeasureMotion() {
+  // Вид вперёд показывает последний кадр предыдущего этапа
+  std::this_thread::sleep_for(kSettleTime);
+  std::unique_lock<std::mutex> lk(state_lock_);
+  phase_ = Phase::kMotion;
+  for (int i = 0; i < events_; ++i) {
+    bool backward = (i % 2) == 0;
+    step_visible_ = !backward;
+    step_pending_ = true;
+    step_time_ = NowMcs();
+    helmet_->Turn(backward);
+    TRACE_INSTANT("PoseStep");
+    state_var_.wait_for(lk, kEventTimeout, [this] { return !step_pending_; });
+    step_pending_ = false;
+
+    // Пауза меняется, чтобы повороты приходились на разные моменты между
+    // развёртками
+    lk.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(40 + (i * 37) % 50));
+    lk.lock();
+  }
+  phase_ = Phase::kIdle;
+}
+
+
+void LatencyHarness::OnFrame(Frame&& frame) {
+  int tag = SyntheticVideoPlayer::ReadColorTag(frame);
+  std::unique_lock<std::mutex> lk(state_lock_);
+  if (phase_ != Phase::kDecode || frames_sent_ >= events_ || tag < 0) {
+    // Кадры вне этапа не показываются: на экране остаётся последний кадр
+    lk.unlock();
+    ReleaseFrame(std::move(frame));
+    return;
+  }
+  tag_times_[tag] = NowMcs();
+  last_sent_tag_ = tag;
+  ++frames_sent_;
+  lk.unlock();
+  state_var_.notify_all();
+  TRACE_INSTANT("TaggedFrame");
+  transformer_->SetImage(std::move(frame));
+}
+
+
+void LatencyHarness::Report(
+    const char* name, int detected, const LatencyHistogram& latency) {
+  std::cout << name << ": " << detected << " of " << events_
+            << " events detected, mean " << int64_t(latency.GetMean())
+            << " us, p50 " << latency.GetPercentile(0.5) << " us, p99 "
+            << latency.GetPercentile(0.99) << " us, max " << latency.GetMax()
+            << " us" << std::endl;
+}
+
+}  // namespace
+
+
+int RunLatencyHarness(int events) {
+  if (events <= 0) {
+    std::cerr << "Wrong amount of latency events" << std::endl;
+    return 1;
+  }
+  LatencyHarness harness(events);
+  return harness.Run();
+}
@@ -0,0 +1,25 @@
+#ifndef LATENCY_HARNESS_H
+#define LATENCY_HARNESS_H
+
+/*! Измерить сквозные задержки конвейера без шлема, фильма и экрана. Настоящий
+трансформатор работает со встроенными заменами: шлемом, положение которого
+задаёт измерение, искусственным проигрывателем и скрытым окном, из которого
+после каждой отрисовки считывается пиксель в центре левого глаза.
+
+Измерение идёт в два этапа:
+  - от кадра до экрана: проигрыватель выдаёт кадры с закодированным цветом
+  номером (см. SyntheticVideoPlayer), задержка считается от передачи кадра
+  трансформатору до вывода буфера с его номером;
+  - от движения до экрана: шлем скачком поворачивается назад и вперёд (сзади
+  изображения нет), задержка считается от поворота до вывода буфера с новым
+  видом.
+
+Распределения задержек сохраняются в гистограммах decode_to_photon_us и
+motion_to_photon_us реестра метрик, поэтому для регрессионных сравнений их
+можно сохранить в JSON (--metrics). Для скрытого окна нужен сервер дисплея,
+например, Xvfb
+\param events количество событий на каждом этапе
+\return код возврата. 0 - если события обнаруживались */
+int RunLatencyHarness(int events);
+
+#endif  // LATENCY_HARNESS_H
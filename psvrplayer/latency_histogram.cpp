@@ -0,0 +1,102 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+
+LatencyHistogram::LatencyHistogram(const std::string& name) : name_(name) {
+  Reset();
+}
+
+
+const std::string& LatencyHistogram::GetName() const { return name_; }
+
+
+void LatencyHistogram::Add(int64_t mcs) {
+  mcs = std::max<int64_t>(mcs, 0);
+  buckets_[BucketIndex(mcs)].fetch_add(1, std::memory_order_relaxed);
+  summ_.fetch_add(mcs, std::memory_order_relaxed);
+
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (mcs > max &&
+         !max_.compare_exchange_weak(max, mcs, std::memory_order_relaxed)) {
+  }
+}
+
+
+uint64_t LatencyHistogram::GetCount() const {
+  uint64_t count = 0;
+  for (const auto& bucket : buckets_) {
+    count += bucket.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+
+double LatencyHistogram::GetMean() const {
+  auto count = GetCount();
+  if (count == 0) {
+    return 0.0;
+  }
+  return double(summ_.load(std::memory_order_relaxed)) / count;
+}
+
+
+int64_t LatencyHistogram::GetPercentile(double fraction) const {
+  uint64_t counts[kBuckets];
+  uint64_t total = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  double target = fraction * total;
+  uint64_t summ = 0;
+  for (int i = 0; i < kBuckets - 1; ++i) {
+    summ += counts[i];
+    if (summ >= target) {
+      return std::min(BucketUpper(i), GetMax());
+    }
+  }
+  return GetMax();
+}
+
+
+int64_t LatencyHistogram::GetMax() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+
+void LatencyHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  summ_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+
+int LatencyHistogram::BucketIndex(int64_t mcs) {
+  if (mcs < kLinearBuckets) {
+    return int(mcs);
+  }
+  int power = kSubBits + 1;
+  while (power < 62 && (mcs >> (power + 1)) != 0) {
+    ++power;
+  }
+  int sub = int((mcs >> (power - kSubBits)) & (kSubBuckets - 1));
+  int index = kLinearBuckets + (power - kSubBits - 1) * kSubBuckets + sub;
+  return std::min(index, kBuckets - 1);
+}
+
+
+int64_t LatencyHistogram::BucketUpper(int index) {
+  if (index < kLinearBuckets) {
+    return index;
+  }
+  int power = (index - kLinearBuckets) / kSubBuckets + kSubBits + 1;
+  int sub = (index - kLinearBuckets) % kSubBuckets;
+  return (int64_t(kSubBuckets + sub + 1) << (power - kSubBits)) - 1;
+}
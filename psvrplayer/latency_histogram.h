@@ -0,0 +1,70 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*! Гистограмма задержек в стиле HDR: до 16 мкс корзины по одной микросекунде,
+дальше каждый интервал между степенями двойки делится на 8 равных корзин
+(относительная точность ~12%). Значения добавляются без блокировок из одного
+или нескольких потоков, читать гистограмму можно из любого потока */
+class LatencyHistogram {
+ public:
+  /*! Создать пустую гистограмму
+  \param name название для отчёта */
+  explicit LatencyHistogram(const std::string& name);
+
+  /*! Выдать название гистограммы */
+  const std::string& GetName() const;
+
+  /*! Учесть задержку
+  \param mcs задержка в микросекундах. Отрицательные считаются нулевыми */
+  void Add(int64_t mcs);
+
+  /*! Выдать количество учтённых задержек */
+  uint64_t GetCount() const;
+
+  /*! Выдать среднюю задержку, мкс. 0 - значений нет */
+  double GetMean() const;
+
+  /*! Выдать оценку сверху для перцентиля задержки
+  \param fraction доля значений, от 0 до 1
+  \return верхняя граница корзины с перцентилем в микросекундах или 0, если
+  значений нет */
+  int64_t GetPercentile(double fraction) const;
+
+  /*! Выдать наибольшую учтённую задержку, мкс */
+  int64_t GetMax() const;
+
+  /*! Очистить гистограмму */
+  void Reset();
+
+ private:
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram(LatencyHistogram&&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+  static const int kLinearBuckets = 16;  //!< Корзины по одной микросекунде
+  static const int kSubBits = 3;  //!< Биты точности после старшего бита
+  static const int kSubBuckets = 1 << kSubBits;  //!< Корзин на степень двойки
+  static const int kMaxPower = 36;  //!< Старшая степень двойки (~19 часов)
+  static const int kBuckets =
+      kLinearBuckets +
+      (kMaxPower - 3) * kSubBuckets;  //!< Количество корзин. Последняя
+                                      //!< вмещает всё большее
+
+  std::string name_;  //!< Название для отчёта
+  std::atomic<uint64_t> buckets_[kBuckets];  //!< Количество значений в корзине
+  std::atomic<int64_t> summ_;  //!< Сумма значений, мкс
+  std::atomic<int64_t> max_;  //!< Наибольшая задержка, мкс
+
+  /*! Выдать номер корзины для значения */
+  static int BucketIndex(int64_t mcs);
+
+  /*! Выдать наибольшее значение корзины */
+  static int64_t BucketUpper(int index);
+};
+
+#endif  // LATENCY_HISTOGRAM_H
@@ -3,15 +3,20 @@
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <cstdlib>
+#include <future>
 #include <iostream>
 #include <map>
-#include <thread>  // TODO Remove debug include
+#include <thread>
 
 #include "config_file.h"
 #include "framepool.h"
+#include "latency_harness.h"
+#include "metrics.h"
 #include "monitors.h"
 #include "play_screen.h"
 #include "playing.h"
+#include "trace.h"
 #include "transformer.h"
 #include "version.h"
 #include "video_player.h"
@@ -28,6 +33,8 @@ const char kHelpMessage[] =
     "  --calibration - calibrate vr helmet device\n"
     "  --listscreens - show list of available screens with their position\n"
     "  --help - show this help\n"
+    "  --latency-test=<events> - measure motion-to-photon and decode-to-photon\n"
+    "      latency with built-in helmet, movie and hidden window\n"
     "  --play=<file-name> - play movie from specified file\n"
     "  --save - save current options as default\n"
     "  --selectdevices - select helmet devices for controlling and sensoring\n"
@@ -35,11 +42,20 @@ const char kHelpMessage[] =
     "  --version - show version information\n"
     "Options:\n"
     "  --eyes=<distance> - specify eyes distance\n"
+    "  --record-sensors=<file> - record raw helmet sensors data to file\n"
+    "  --replay-sensors=<file> - use recorded sensors data instead of helmet\n"
+    "  --replay-speed=<times> - speedup sensors replay, 0 - without pauses\n"
     /*    "  --layer=sbs|ou|mono - specify layer configuration\n" */
     "  --rotation[+][+] - speedup helm rotation\n"
     "  --screen=<position> - specify screen (by position) to play movie\n"
     /* "  --swapcolor - correct color\n" */
     "  --swaplayer - correct order of layers\n"
+    "  --synthetic-helmet=<script> - use scripted head motion instead of helmet\n"
+    "      e.g. 'sweep:30:4:8;snap:45:0.1;hold:1;jitter:0.3:2'\n"
+    "  --synthetic-video - play generated movie, movie name describes it as\n"
+    "      <width>x<height>:<fps>:sbs|ou|mono[:<seconds>], e.g. '3840x1080:60:sbs'\n"
+    "  --trace=<file> - save threads events timeline in Chrome trace format\n"
+    "  --metrics=<file> - save metrics summary as JSON (M key - dump now)\n"
     /*    "  --vision=full|semi|flat - specify area of vision\n" */
     "More information see on https://apoheliy.com/psvrplayer/\n"
     "";
@@ -59,9 +75,14 @@ enum ParamCmd {
   kCmdCalibration,
   kCmdEyes,
   kCmdHelp,
+  kCmdLatencyTest,
   kCmdLayer,
   kCmdListScreens,
+  kCmdMetrics,
   kCmdPlay,
+  kCmdRecordSensors,
+  kCmdReplaySensors,
+  kCmdReplaySpeed,
   kCmdReset,
   kCmdRotationSpeedup,
   kCmdSave,
@@ -70,6 +91,9 @@ enum ParamCmd {
   kCmdShow,
   kCmdSwapColor,
   kCmdSwapLayer,
+  kCmdSyntheticHelmet,
+  kCmdSyntheticVideo,
+  kCmdTrace,
   kCmdVersion,
   kCmdVision
 };
@@ -93,13 +117,18 @@ struct CommandLineValue {
 };
 
 // clang-format off
-std::array<CommandLineParam, 16> CmdParameters = {{
+std::array<CommandLineParam, 24> CmdParameters = {{
   {kCmdCalibration, true, false, kEmptyValue, "--calibration", "calibration command"},
   {kCmdEyes, false, false, kNumberValue, "--eyes=", "interpupillary distance"},
   {kCmdHelp, true, false, kEmptyValue, "--help", "help command"},
+  {kCmdLatencyTest, true, false, kNumberValue, "--latency-test=", "measure pipeline latency"},
   {kCmdLayer, false, false, kStringValue, "--layer=", "layer switcher"},
   {kCmdListScreens, true, false, kEmptyValue, "--listscreens", "list screens command"},
+  {kCmdMetrics, false, false, kStringValue, "--metrics=", "save metrics summary"},
   {kCmdPlay, true, true, kStringValue, "--play=", "play movie file"},
+  {kCmdRecordSensors, false, false, kStringValue, "--record-sensors=", "record sensors data"},
+  {kCmdReplaySensors, false, false, kStringValue, "--replay-sensors=", "replay sensors data"},
+  {kCmdReplaySpeed, false, false, kNumberValue, "--replay-speed=", "sensors replay speed"},
   {kCmdReset, true, false, kEmptyValue, "--reset", "reset saved options and calibration"},
   {kCmdRotationSpeedup, false, false, kStringValue, "--rotation", "rotation speedup"},
   {kCmdSave, true, false, kEmptyValue, "--save", "save current option"},
@@ -108,6 +137,9 @@ std::array<CommandLineParam, 16> CmdParameters = {{
   {kCmdShow, true, false, kStringValue, "--show=", "show test images"},
   {kCmdSwapColor, false, false, kEmptyValue, "--swapcolor", "change color palette"},
   {kCmdSwapLayer, false, false, kEmptyValue, "--swaplayer", "swap left/right view"},
+  {kCmdSyntheticHelmet, false, false, kStringValue, "--synthetic-helmet=", "scripted helmet motion"},
+  {kCmdSyntheticVideo, false, false, kEmptyValue, "--synthetic-video", "generated movie"},
+  {kCmdTrace, false, false, kStringValue, "--trace=", "save events trace"},
   {kCmdVersion, true, false, kEmptyValue, "--version", "show version information"},
   {kCmdVision, false, false, kStringValue, "--vision=", "selects format of 3D movie"},
 }};
@@ -121,6 +153,13 @@ bool cmd_swap_color = false;
 bool cmd_swap_layer = false;
 int cmd_eyes_distance = 0;
 double cmd_rotation = 1.0;
+std::string cmd_record_sensors;
+std::string cmd_replay_sensors;
+int cmd_replay_speed = 1;
+std::string cmd_synthetic_helmet;
+bool cmd_synthetic_video = false;
+std::string cmd_trace;
+std::string cmd_metrics;
 
 enum CmdVision {
   kVisionFull,
@@ -309,6 +348,49 @@ bool CheckParameters() {
     cmd_rotation = 1.0 + 0.25 * pc;
   }
 
+  l = CmdValues.find(kCmdRecordSensors);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_record_sensors = l->second[0].strvalue;
+  }
+
+  l = CmdValues.find(kCmdReplaySensors);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_replay_sensors = l->second[0].strvalue;
+  }
+
+  l = CmdValues.find(kCmdReplaySpeed);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_replay_speed = l->second[0].numvalue;
+    if (cmd_replay_speed < 0) {
+      std::cerr << "Wrong replay speed" << std::endl;
+      return false;
+    }
+  }
+
+  l = CmdValues.find(kCmdSyntheticHelmet);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_synthetic_helmet = l->second[0].strvalue;
+  }
+
+  if (CmdValues.find(kCmdSyntheticVideo) != CmdValues.end()) {
+    cmd_synthetic_video = true;
+  }
+
+  l = CmdValues.find(kCmdTrace);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_trace = l->second[0].strvalue;
+  }
+
+  l = CmdValues.find(kCmdMetrics);
+  if (l != CmdValues.end() && !l->second.empty()) {
+    cmd_metrics = l->second[0].strvalue;
+  }
+
+  if (!cmd_record_sensors.empty() && !cmd_replay_sensors.empty()) {
+    std::cerr << "Sensors can't be recorded and replayed together" << std::endl;
+    return false;
+  }
+
   return true;
 }
 
@@ -316,13 +398,42 @@ bool CheckParameters() {
 void PrintHelp() { std::cout << kHelpMessage << std::endl; }
 
 
+/*! Создать шлем: искусственный по сценарию из командной строки или настоящий
+\return шлем или пустой указатель, если шлема нет */
+std::shared_ptr<IHelmet> CreateHelmet() {
+  if (!cmd_synthetic_helmet.empty()) {
+    return CreateSyntheticHelmet(cmd_synthetic_helmet);
+  }
+  return CreateHelmetView();
+}
+
+
 /*! Выполнить команду play - проигрывания файла. При воспроизведении передаётся
 указатель на ранее созданный экземпляр управления шлемом, т.к. закрытие и
 повторное открытие устройства может приводить с ошибкам.
+Этапы запуска идут параллельно: библиотека vlc создаётся и разбирает файл в
+отдельном потоке, пока создаётся окно и идёт настройка OpenGL (в потоке
+трансформации), а шлем может ещё открываться.
 \param fname имя файла для воспроизведения
-\param vr экземпляр управления шлемом
+\param helmet_future экземпляр управления шлемом (может быть ещё не создан)
 \return код возврата. 0 - если нет ошибок */
-int DoPlayCommand(std::string fname, std::shared_ptr<IHelmet> helmet) {
+int DoPlayCommand(std::string fname,
+    std::shared_future<std::shared_ptr<IHelmet>> helmet_future) {
+  auto vp_future = std::async(std::launch::async, [fname]() {
+    auto vp = cmd_synthetic_video ? CreateSyntheticVideoPlayer()
+                                  : CreateVideoPlayer();
+    if (vp && !vp->OpenMovie(fname)) {
+      std::cerr << "Can't open movie '" << fname << "'" << std::endl;
+    }
+    return vp;
+  });
+
+  auto ps = CreatePlayScreen(cmd_screen);
+  if (!ps) {
+    return 1;
+  }
+
+  auto helmet = helmet_future.get();
   if (helmet) {
     bool vr_mode = (cmd_layer == kLayerSbs) || (cmd_layer == kLayerOu);
     helmet->SetVRMode(vr_mode ? IHelmet::VRMode::kSplitScreen
@@ -330,11 +441,6 @@ int DoPlayCommand(std::string fname, std::shared_ptr<IHelmet> helmet) {
     helmet->SetRotationSpeedup(cmd_rotation);
   }
 
-  auto ps = CreatePlayScreen(cmd_screen);
-  if (!ps) {
-    return 1;
-  }
-
   TransformerScheme sch = kLeftRight180;
   StreamsScheme ss = kLeftRightStreams;
   switch (cmd_vision) {
@@ -369,17 +475,14 @@ int DoPlayCommand(std::string fname, std::shared_ptr<IHelmet> helmet) {
   trf->SetEyeSwap(cmd_swap_layer);
   trf->SetEyesDistance(cmd_eyes_distance);
 
-  auto vp = CreateVideoPlayer();
+  auto vp = vp_future.get();
   if (!vp) {
     return 1;
   }
 
-  if (!vp->OpenMovie(fname)) {
-    std::cerr << "Can't open movie '" << fname << "'" << std::endl;
-  }
-
-  while (vp->GetMovieState() == IVideoPlayer::MovieState::kMovieParsing) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  if (vp->WaitMovieParsed() == IVideoPlayer::MovieState::kMovieReadyToPlay) {
+    auto fps = vp->GetFrameRate();
+    trf->SetFramePacing(fps, ps->SelectRefreshRate(fps));
   }
 
   // TODO Remove debug
@@ -387,6 +490,13 @@ int DoPlayCommand(std::string fname, std::shared_ptr<IHelmet> helmet) {
 
   vp->Play();
 
+  bool pause_when_removed = false;
+  Config::GetPowerOptions(&pause_when_removed);
+  if (helmet && pause_when_removed) {
+    helmet->SetWornFn(
+        [vp, trf](bool worn) { HeadsetProcessor(worn, vp, trf); });
+  }
+
   if (ps) {
     ps->SetKeyboardFilter(
         [vp, helmet](int key, int scancode, int action, int mods) {
@@ -397,6 +507,9 @@ int DoPlayCommand(std::string fname, std::shared_ptr<IHelmet> helmet) {
     ps->SetKeyboardFilter({});
   }
 
+  if (helmet) {
+    helmet->SetWornFn({});
+  }
   vp->SetDisplayFn({});
 
   assert(trf.use_count() == 1);
@@ -450,7 +563,7 @@ Frame GenerateColors() {
 /*! Выполнить команду show
 \return код возврата. 0 - если нет ошибок */
 int DoShowCommand(std::string figure) {
-  auto vr = CreateHelmetView();
+  auto vr = CreateHelmet();
   if (!vr) {
     std::cerr << "PS VR Helmet not found" << std::endl;
   } else {
@@ -626,6 +739,16 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  PsvrHelmetHid::SetSensorsRecording(cmd_record_sensors);
+  PsvrHelmetHid::SetSensorsReplay(cmd_replay_sensors, cmd_replay_speed);
+
+  // Трассировка сохраняется при любом выходе из программы
+  if (!cmd_trace.empty() && Trace::Start(cmd_trace)) {
+    std::atexit(Trace::Stop);
+  }
+  Metrics::Start(cmd_metrics);
+  std::atexit(Metrics::Stop);
+
   int res = 0;
   switch (cmd) {
     case kCmdCalibration:
@@ -634,24 +757,39 @@ int main(int argc, char** argv) {
     case kCmdHelp:
       PrintHelp();
       break;
+    case kCmdLatencyTest: {
+      auto l = CmdValues.find(kCmdLatencyTest);
+      if (l != CmdValues.end() && !l->second.empty()) {
+        return RunLatencyHarness(l->second[0].numvalue);
+      }
+    } break;
     case kCmdListScreens:
       res = PrintMonitors();
       break;
     case kCmdPlay: {
       auto l = CmdValues.find(kCmdPlay);
       if (l != CmdValues.end()) {
-        auto vr = CreateHelmetView();
-        if (!vr) {
-          std::cerr << "PS VR Helmet not found" << std::endl;
-        }
+        PrepareVideoPlayer();
+
+        // Шлем открывается параллельно с остальными этапами запуска
+        std::shared_future<std::shared_ptr<IHelmet>> vr_future =
+            std::async(std::launch::async, []() {
+              auto vr = CreateHelmet();
+              if (!vr) {
+                std::cerr << "PS VR Helmet not found" << std::endl;
+              }
+              return vr;
+            }).share();
 
         for (auto it = l->second.begin(); it != l->second.end(); ++it) {
-          auto r = DoPlayCommand(it->strvalue, vr);
+          auto r = DoPlayCommand(it->strvalue, vr_future);
           if (res == 0) {
             res = r;
           }
         }
 
+        auto vr = vr_future.get();
+        vr_future = decltype(vr_future)();
         assert(vr.use_count() < 2);
       }
     } break;
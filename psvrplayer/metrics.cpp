@@ -0,0 +1,219 @@
+#include "metrics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "config_file.h"
+#include "version.h"
+
+namespace {
+
+std::mutex g_MetricsLock;  //!< Блокировка реестра
+std::map<std::string, std::unique_ptr<Metrics::Counter>> g_Counters;
+std::map<std::string, std::unique_ptr<Metrics::Gauge>> g_Gauges;
+std::map<std::string, std::unique_ptr<LatencyHistogram>> g_Histograms;
+
+std::mutex g_DumpLock;  //!< Блокировка вывода и потока периодического вывода
+std::condition_variable g_DumpVar;  //!< Событие остановки периодического вывода
+std::thread g_DumpThread;  //!< Поток периодического вывода
+bool g_DumpShutdown = false;  //!< Флаг остановки периодического вывода
+std::string g_JsonFileName;  //!< Файл для сводки в JSON
+auto g_MetricsStart =
+    std::chrono::steady_clock::now();  //!< Начало сбора метрик
+
+
+/*! Записать строку в формате JSON */
+void WriteString(std::ostream& out, const std::string& text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+
+/*! Выдать время с начала сбора метрик, сек */
+double Uptime() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - g_MetricsStart)
+      .count();
+}
+
+
+/*! Вывести сводку. Вызывается под g_DumpLock */
+void DumpLocked() {
+  auto text = Metrics::FormatText();
+  if (!text.empty()) {
+    std::cerr << text << std::flush;
+  }
+  if (!g_JsonFileName.empty()) {
+    std::ofstream out(g_JsonFileName, std::ios_base::out | std::ios_base::trunc);
+    if (!out) {
+      std::cerr << "Can't create metrics file '" << g_JsonFileName << "'"
+                << std::endl;
+      return;
+    }
+    out << Metrics::FormatJson();
+  }
+}
+
+}  // namespace
+
+
+Metrics::Counter& Metrics::GetCounter(const std::string& name) {
+  std::lock_guard<std::mutex> lk(g_MetricsLock);
+  auto& metric = g_Counters[name];
+  if (!metric) {
+    metric.reset(new Counter());
+  }
+  return *metric;
+}
+
+
+Metrics::Gauge& Metrics::GetGauge(const std::string& name) {
+  std::lock_guard<std::mutex> lk(g_MetricsLock);
+  auto& metric = g_Gauges[name];
+  if (!metric) {
+    metric.reset(new Gauge());
+  }
+  return *metric;
+}
+
+
+LatencyHistogram& Metrics::GetHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lk(g_MetricsLock);
+  auto& metric = g_Histograms[name];
+  if (!metric) {
+    metric.reset(new LatencyHistogram(name));
+  }
+  return *metric;
+}
+
+
+void Metrics::Start(const std::string& json_fname) {
+  int period = 0;
+  Config::GetMetricsOptions(&period);
+
+  std::lock_guard<std::mutex> lk(g_DumpLock);
+  g_JsonFileName = json_fname;
+  if (period <= 0 || g_DumpThread.joinable()) {
+    return;
+  }
+  g_DumpShutdown = false;
+  std::thread t([period]() {
+    std::unique_lock<std::mutex> lk(g_DumpLock);
+    while (!g_DumpVar.wait_for(lk, std::chrono::seconds(period),
+        [] { return g_DumpShutdown; })) {
+      DumpLocked();
+    }
+  });
+  std::swap(g_DumpThread, t);
+}
+
+
+void Metrics::Dump() {
+  std::lock_guard<std::mutex> lk(g_DumpLock);
+  DumpLocked();
+}
+
+
+void Metrics::Stop() {
+  std::unique_lock<std::mutex> lk(g_DumpLock);
+  g_DumpShutdown = true;
+  lk.unlock();
+  g_DumpVar.notify_all();
+  if (g_DumpThread.joinable()) {
+    g_DumpThread.join();
+  }
+  Dump();
+}
+
+
+std::string Metrics::FormatText() {
+  std::lock_guard<std::mutex> lk(g_MetricsLock);
+  if (g_Counters.empty() && g_Gauges.empty() && g_Histograms.empty()) {
+    return std::string();
+  }
+
+  std::ostringstream out;
+  char uptime[32];
+  std::snprintf(uptime, sizeof(uptime), "%.1f", Uptime());
+  out << "Metrics at " << uptime << " s:" << std::endl;
+  for (const auto& counter : g_Counters) {
+    out << "  " << counter.first << ": " << counter.second->Get()
+        << std::endl;
+  }
+  for (const auto& gauge : g_Gauges) {
+    out << "  " << gauge.first << ": " << gauge.second->Get() << std::endl;
+  }
+  for (const auto& histogram : g_Histograms) {
+    const LatencyHistogram& h = *histogram.second;
+    if (h.GetCount() == 0) {
+      continue;
+    }
+    char mean[32];
+    std::snprintf(mean, sizeof(mean), "%.1f", h.GetMean());
+    out << "  " << histogram.first << ": " << h.GetCount()
+        << " samples, mean " << mean << ", p50 " << h.GetPercentile(0.5)
+        << ", p99 " << h.GetPercentile(0.99) << ", p99.9 "
+        << h.GetPercentile(0.999) << ", max " << h.GetMax() << std::endl;
+  }
+  return out.str();
+}
+
+
+std::string Metrics::FormatJson() {
+  std::lock_guard<std::mutex> lk(g_MetricsLock);
+  std::ostringstream out;
+  char uptime[32];
+  std::snprintf(uptime, sizeof(uptime), "%.3f", Uptime());
+  out << "{\n  \"version\": \"" << kVersion << "\",\n  \"uptime\": "
+      << uptime << ",\n  \"counters\": {";
+  const char* separator = "";
+  for (const auto& counter : g_Counters) {
+    out << separator << "\n    ";
+    WriteString(out, counter.first);
+    out << ": " << counter.second->Get();
+    separator = ",";
+  }
+  out << "\n  },\n  \"gauges\": {";
+  separator = "";
+  for (const auto& gauge : g_Gauges) {
+    out << separator << "\n    ";
+    WriteString(out, gauge.first);
+    out << ": " << gauge.second->Get();
+    separator = ",";
+  }
+  out << "\n  },\n  \"histograms\": {";
+  separator = "";
+  for (const auto& histogram : g_Histograms) {
+    const LatencyHistogram& h = *histogram.second;
+    char mean[32];
+    std::snprintf(mean, sizeof(mean), "%.3f", h.GetMean());
+    out << separator << "\n    ";
+    WriteString(out, histogram.first);
+    out << ": {\"count\": " << h.GetCount() << ", \"mean\": " << mean
+        << ", \"p50\": " << h.GetPercentile(0.5)
+        << ", \"p90\": " << h.GetPercentile(0.9)
+        << ", \"p99\": " << h.GetPercentile(0.99)
+        << ", \"p999\": " << h.GetPercentile(0.999)
+        << ", \"max\": " << h.GetMax() << "}";
+    separator = ",";
+  }
+  out << "\n  }\n}\n";
+  return out.str();
+}
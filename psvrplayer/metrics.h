@@ -0,0 +1,87 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "latency_histogram.h"
+
+/*! Общий реестр метрик: счётчики, текущие значения и гистограммы задержек.
+Метрика создаётся при первом запросе по имени и живёт до конца работы,
+поэтому ссылку на неё можно сохранить (например, в статической переменной) и
+обновлять метрику без блокировок. Сводка выводится текстом в std::cerr и в
+JSON-файл: периодически, по запросу и при завершении */
+namespace Metrics {
+
+/*! Монотонный счётчик событий */
+class Counter {
+ public:
+  Counter() : value_(0) {}
+
+  /*! Увеличить счётчик */
+  void Add(uint64_t amount = 1) {
+    value_.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  /*! Выдать значение счётчика */
+  uint64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  std::atomic<uint64_t> value_;  //!< Значение счётчика
+};
+
+/*! Текущее значение величины, например, размер пула */
+class Gauge {
+ public:
+  Gauge() : value_(0) {}
+
+  /*! Выставить значение */
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+
+  /*! Выдать значение */
+  int64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  Gauge(const Gauge&) = delete;
+  Gauge& operator=(const Gauge&) = delete;
+
+  std::atomic<int64_t> value_;  //!< Текущее значение
+};
+
+/*! Выдать счётчик по имени, создав его при первом запросе. Функция
+потокобезопасная */
+Counter& GetCounter(const std::string& name);
+
+/*! Выдать текущее значение по имени, создав его при первом запросе. Функция
+потокобезопасная */
+Gauge& GetGauge(const std::string& name);
+
+/*! Выдать гистограмму задержек (в микросекундах) по имени, создав её при
+первом запросе. Функция потокобезопасная */
+LatencyHistogram& GetHistogram(const std::string& name);
+
+/*! Начать периодический вывод сводки. Период берётся из конфигурации
+(секция [Metrics], ключ period в секундах, 0 - без периодического вывода)
+\param json_fname файл для сводки в формате JSON. Пустое имя - только текст */
+void Start(const std::string& json_fname);
+
+/*! Вывести сводку текстом в std::cerr и, если задан, в JSON-файл. Функция
+потокобезопасная */
+void Dump();
+
+/*! Остановить периодический вывод и вывести итоговую сводку */
+void Stop();
+
+/*! Сформировать сводку текстом */
+std::string FormatText();
+
+/*! Сформировать сводку в формате JSON */
+std::string FormatJson();
+
+}  // namespace Metrics
+
+#endif  // METRICS_H
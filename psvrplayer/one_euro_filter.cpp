@@ -0,0 +1,75 @@
+#include "one_euro_filter.h"
+
+#include <cmath>
+
+const double kPi = 3.1415926535897932384626433832795;
+
+
+OneEuroFilter::OneEuroFilter()
+    : min_cutoff_(0.0), beta_(0.0), speed_cutoff_(1.0) {
+  Reset();
+}
+
+
+void OneEuroFilter::SetParameters(
+    double min_cutoff, double beta, double speed_cutoff) {
+  min_cutoff_ = min_cutoff;
+  beta_ = beta;
+  speed_cutoff_ = speed_cutoff;
+  Reset();
+}
+
+
+bool OneEuroFilter::IsEnabled() const { return min_cutoff_ > 0.0; }
+
+
+void OneEuroFilter::Filter(double* velocity, double dt) {
+  if (!IsEnabled() || dt <= 0.0) {
+    return;
+  }
+  if (!has_value_) {
+    has_value_ = true;
+    for (int i = 0; i < 3; ++i) {
+      value_[i] = velocity[i];
+    }
+    return;
+  }
+
+  double speed = std::sqrt(velocity[0] * velocity[0] +
+                           velocity[1] * velocity[1] +
+                           velocity[2] * velocity[2]);
+  speed_ += (speed - speed_) * Alpha(speed_cutoff_, dt);
+  cutoff_ = min_cutoff_ + beta_ * speed_;
+
+  double a = Alpha(cutoff_, dt);
+  for (int i = 0; i < 3; ++i) {
+    value_[i] += (velocity[i] - value_[i]) * a;
+    velocity[i] = value_[i];
+  }
+}
+
+
+double OneEuroFilter::GetLatency() const {
+  if (!IsEnabled() || cutoff_ <= 0.0) {
+    return 0.0;
+  }
+  // Задержка фильтра первого порядка на низких частотах - его постоянная
+  // времени
+  return 1.0 / (2.0 * kPi * cutoff_);
+}
+
+
+void OneEuroFilter::Reset() {
+  has_value_ = false;
+  for (auto& v : value_) {
+    v = 0.0;
+  }
+  speed_ = 0.0;
+  cutoff_ = min_cutoff_;
+}
+
+
+double OneEuroFilter::Alpha(double cutoff, double dt) {
+  double tau = 1.0 / (2.0 * kPi * cutoff);
+  return 1.0 / (1.0 + tau / dt);
+}
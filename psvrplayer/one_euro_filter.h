@@ -0,0 +1,50 @@
+#ifndef ONE_EURO_FILTER_H
+#define ONE_EURO_FILTER_H
+
+/*! Адаптивный фильтр низких частот One-Euro для угловой скорости шлема по
+трём осям. На малых скоростях частота среза низкая и дрожание головы и шум
+сенсоров подавляются, с ростом скорости частота среза растёт и фильтр почти
+не добавляет задержку. Фильтруемый сигнал сам является скоростью, поэтому
+частота среза подстраивается по сглаженному модулю скорости, а не по его
+производной. Используется в одном потоке */
+class OneEuroFilter {
+ public:
+  OneEuroFilter();
+
+  /*! Задать параметры фильтра
+  \param min_cutoff частота среза в покое, Гц. 0 - фильтр выключен
+  \param beta прирост частоты среза на единицу скорости, Гц на градус в
+  секунду
+  \param speed_cutoff частота среза для сглаживания модуля скорости, Гц */
+  void SetParameters(double min_cutoff, double beta, double speed_cutoff);
+
+  /*! Признак включённого фильтра */
+  bool IsEnabled() const;
+
+  /*! Отфильтровать скорость. Скорость фильтруется на месте
+  \param velocity скорость по трём осям, градусы в секунду
+  \param dt интервал с прошлого измерения, сек */
+  void Filter(double* velocity, double dt);
+
+  /*! Выдать задержку, которую фильтр вносит на текущей частоте среза
+  \return задержка в секундах */
+  double GetLatency() const;
+
+  /*! Сбросить состояние фильтра */
+  void Reset();
+
+ private:
+  double min_cutoff_;  //!< Частота среза в покое, Гц
+  double beta_;  //!< Прирост частоты среза от скорости
+  double speed_cutoff_;  //!< Частота среза для модуля скорости, Гц
+
+  bool has_value_;  //!< Признак, что фильтр уже получил значение
+  double value_[3];  //!< Отфильтрованная скорость
+  double speed_;  //!< Сглаженный модуль скорости
+  double cutoff_;  //!< Текущая частота среза, Гц
+
+  /*! Коэффициент экспоненциального сглаживания для частоты среза */
+  static double Alpha(double cutoff, double dt);
+};
+
+#endif  // ONE_EURO_FILTER_H
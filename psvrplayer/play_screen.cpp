@@ -1,6 +1,7 @@
 #include "play_screen.h"
 
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -19,6 +20,11 @@ const int kDefaultQuitScancode =
         //! клавиши в glfw определяются как неподдерживаемые)
 int quit_scancode_ = kDefaultQuitScancode;
 
+const int kRefreshRates[] = {
+    120, 90, 60};  //!< Частоты обновления для выбора, в порядке предпочтения
+const double kCadenceTolerance =
+    0.02;  //!< Допустимое отклонение кратности частот (для 23.976 и т.п.)
+
 class OpenGLScreen: public IPlayScreen {
  public:
   OpenGLScreen(std::string screen);
@@ -28,6 +34,7 @@ class OpenGLScreen: public IPlayScreen {
   void SetKeyboardFilter(std::function<void(int, int, int, int)> fn) override;
   void SetMouseEvent(std::function<void(double, double)> fn) override;
   void MakeScreenCurrent() override;
+  int SelectRefreshRate(double frame_rate) override;
   void DisplayBuffer() override;
   void GetFrameSize(int& width, int& height) override;
 
@@ -40,6 +47,7 @@ class OpenGLScreen: public IPlayScreen {
   OpenGLScreen& operator=(OpenGLScreen&&) = delete;
 
   GLFWwindow* window_;
+  GLFWmonitor* monitor_;
   std::function<void(int, int, int, int)> key_processor_;
   std::function<void(double, double)> mouse_processor_;
   std::mutex
@@ -99,7 +107,8 @@ IPlayScreenPtr CreatePlayScreen(std::string screen) {
 }
 
 
-OpenGLScreen::OpenGLScreen(std::string screen): window_(nullptr) {
+OpenGLScreen::OpenGLScreen(std::string screen)
+    : window_(nullptr), monitor_(nullptr) {
   if (!glfwInit()) {
     throw std::runtime_error("Can't initialize GLFW library");
   }
@@ -112,6 +121,7 @@ OpenGLScreen::OpenGLScreen(std::string screen): window_(nullptr) {
     if (!window_) {
       throw std::runtime_error("Can't create window for screen");
     }
+    monitor_ = mon;
 
     auto phk = glfwSetKeyCallback(window_, OnKeyRaw);
     assert(!phk);
@@ -196,6 +206,47 @@ void OpenGLScreen::SetMouseEvent(std::function<void(double, double)> fn) {
 void OpenGLScreen::MakeScreenCurrent() {
   assert(window_);
   glfwMakeContextCurrent(window_);
+  glfwSwapInterval(1);
+}
+
+int OpenGLScreen::SelectRefreshRate(double frame_rate) {
+  assert(window_);
+  assert(monitor_);
+  const GLFWvidmode* cur = glfwGetVideoMode(monitor_);
+  if (!cur) {
+    return 0;
+  }
+  if (frame_rate <= 0.0) {
+    return cur->refreshRate;
+  }
+
+  int amount = 0;
+  const GLFWvidmode* modes = glfwGetVideoModes(monitor_, &amount);
+  for (int rate : kRefreshRates) {
+    double cadence = rate / frame_rate;
+    if (cadence < 1.0 ||
+        std::abs(cadence - std::round(cadence)) > kCadenceTolerance) {
+      continue;
+    }
+    if (rate == cur->refreshRate) {
+      return rate;
+    }
+    for (int i = 0; i < amount; ++i) {
+      if (modes[i].width == cur->width && modes[i].height == cur->height &&
+          modes[i].refreshRate == rate) {
+        glfwSetWindowMonitor(
+            window_, monitor_, 0, 0, cur->width, cur->height, rate);
+        std::cout << "Screen refresh rate " << rate << " Hz is selected for "
+                  << frame_rate << " fps" << std::endl;
+        return rate;
+      }
+    }
+  }
+
+  std::cerr << "WARNING: No screen mode with refresh rate multiple of "
+            << frame_rate << " fps. Refresh rate " << cur->refreshRate
+            << " Hz is used" << std::endl;
+  return cur->refreshRate;
 }
 
 void OpenGLScreen::DisplayBuffer() { glfwSwapBuffers(window_); }
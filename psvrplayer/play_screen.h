@@ -29,9 +29,17 @@ class IPlayScreen {
   x_pos и y_pos это позиция указателя мыши. \param fn функция обработки */
   virtual void SetMouseEvent(std::function<void(double, double)> fn) = 0;
 
-  /*! Сделать окно как текущее в вызываемом потоке */
+  /*! Сделать окно как текущее в вызываемом потоке. Также включается
+  синхронизация вывода буфера с кадровой развёрткой экрана (vsync) */
   virtual void MakeScreenCurrent() = 0;
 
+  /*! Выбрать режим экрана с частотой обновления (60/90/120 Гц), кратной
+  частоте кадров фильма. Если подходящего режима нет, то режим не меняется.
+  Вызывается только в основном потоке
+  \param frame_rate частота кадров фильма. 0 - частота неизвестна
+  \return частота обновления экрана после выбора режима, в Гц */
+  virtual int SelectRefreshRate(double frame_rate) = 0;
+
   virtual void DisplayBuffer() = 0;
 
   virtual void GetFrameSize(int& width, int& height) = 0;
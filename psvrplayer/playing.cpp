@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <mutex>
 
 // clang-format off
 // Glfw library includes
@@ -11,6 +12,7 @@
 #include <GLFW/glfw3.h>
 // clang-format on
 
+#include "metrics.h"
 #include "transformer.h"
 #include "video_player.h"
 #include "vr_helmet.h"
@@ -22,6 +24,8 @@ int scancode_right_arrow_ = 114;
 int scancode_left_ctrl_ = 37;
 
 bool pause_state_ = false;
+bool removed_state_ = false;  //!< Шлем снят
+std::mutex pause_lock_;  //!< Блокировка для pause_state_ и removed_state_
 
 struct KeySeq {
   //! Время предыдущего нажатия
@@ -79,8 +83,10 @@ int GetMovement(MultiKey m) {
 void KeyProcessor(int key, int scancode, int action, int mods,
     std::shared_ptr<IVideoPlayer> player, std::shared_ptr<IHelmet> helmet) {
   if (scancode == scancode_space_ && action == GLFW_PRESS && mods == 0) {
+    std::unique_lock<std::mutex> lk(pause_lock_);
     pause_state_ = !pause_state_;
-    player->Pause(pause_state_);
+    player->Pause(pause_state_ || removed_state_);
+    lk.unlock();
 
     // Additional alignment action
     central_x = last_x;
@@ -108,6 +114,24 @@ void KeyProcessor(int key, int scancode, int action, int mods,
       helmet) {
     helmet->CenterView();
   }
+
+  if (key == GLFW_KEY_M && action == GLFW_PRESS && mods == 0) {
+    Metrics::Dump();
+  }
+}
+
+
+void HeadsetProcessor(bool worn, std::shared_ptr<IVideoPlayer> player,
+    std::shared_ptr<Transformer> transformer) {
+  std::lock_guard<std::mutex> lk(pause_lock_);
+  // Состояние применяется и без смены: плеер может быть новым
+  if (removed_state_ == worn) {
+    std::cerr << (worn ? "Helmet is put on" : "Helmet is taken off, pause")
+              << std::endl;
+  }
+  removed_state_ = !worn;
+  player->Pause(pause_state_ || removed_state_);
+  transformer->SetIdle(removed_state_);
 }
 
 
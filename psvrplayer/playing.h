@@ -11,6 +11,12 @@ class Transformer;
 void KeyProcessor(int key, int scancode, int action, int mods,
     std::shared_ptr<IVideoPlayer> player, std::shared_ptr<IHelmet> helmet);
 
+/*! Обработчик надевания и снятия шлема: пока шлем снят, воспроизведение
+приостановлено, а отрисовка переведена в экономный режим. Пауза по клавиатуре
+при этом сохраняется. Может вызываться из любого потока */
+void HeadsetProcessor(bool worn, std::shared_ptr<IVideoPlayer> player,
+    std::shared_ptr<Transformer> transformer);
+
 void MouseProcessor(double x_pos, double y_pos, Transformer* transformer);
 
 #endif  // PLAYING_H
@@ -0,0 +1,118 @@
+#include "pose_history.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+PoseHistory::PoseHistory() : head_(0), first_(0) {
+  for (auto& slot : slots_) {
+    slot.version = 0;
+    slot.time = 0;
+    for (auto& d : slot.data) {
+      d = 0.0;
+    }
+  }
+}
+
+
+void PoseHistory::Add(const Pose& pose) {
+  auto head = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[head % kCapacity];
+  auto version = slot.version.load(std::memory_order_relaxed);
+  slot.version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time.store(pose.time, std::memory_order_relaxed);
+  slot.data[0].store(pose.orientation.w, std::memory_order_relaxed);
+  slot.data[1].store(pose.orientation.x, std::memory_order_relaxed);
+  slot.data[2].store(pose.orientation.y, std::memory_order_relaxed);
+  slot.data[3].store(pose.orientation.z, std::memory_order_relaxed);
+  slot.data[4].store(pose.velocity.x, std::memory_order_relaxed);
+  slot.data[5].store(pose.velocity.y, std::memory_order_relaxed);
+  slot.data[6].store(pose.velocity.z, std::memory_order_relaxed);
+  slot.version.store(version + 2, std::memory_order_release);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+
+void PoseHistory::Clear() {
+  first_.store(head_.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+
+bool PoseHistory::GetPoseAt(int64_t time, glm::dquat& orientation) const {
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    auto head = head_.load(std::memory_order_acquire);
+    auto first = first_.load(std::memory_order_acquire);
+    // Самая старая ячейка может переписываться прямо сейчас
+    if (head > kCapacity - 1) {
+      first = std::max(first, head - (kCapacity - 1));
+    }
+    if (head <= first) {
+      return false;
+    }
+
+    Pose newer;
+    if (!ReadSlot(head - 1, newer)) {
+      continue;
+    }
+    if (time >= newer.time) {
+      // Экстраполяция поворотом с последней угловой скоростью
+      double dt = std::min(time - newer.time, kMaxExtrapolation) * 0.000001;
+      double speed = glm::length(newer.velocity);
+      orientation = newer.orientation;
+      if (speed > 0.0) {
+        orientation = glm::normalize(
+            glm::angleAxis(speed * dt, newer.velocity * (1.0 / speed)) *
+            newer.orientation);
+      }
+      return true;
+    }
+
+    // Ищем пару соседних положений вокруг заданного времени. Обычно запросы
+    // идут на недавнее время, поэтому поиск начинается с конца
+    bool broken = false;
+    for (auto index = head - 1; index > first; --index) {
+      Pose older;
+      if (!ReadSlot(index - 1, older)) {
+        broken = true;
+        break;
+      }
+      if (older.time <= time) {
+        double span = double(newer.time - older.time);
+        double t = span > 0.0 ? double(time - older.time) / span : 1.0;
+        orientation =
+            glm::normalize(glm::slerp(older.orientation, newer.orientation, t));
+        return true;
+      }
+      newer = older;
+    }
+    if (!broken) {
+      // Время раньше всей истории
+      orientation = newer.orientation;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool PoseHistory::ReadSlot(uint64_t index, Pose& pose) const {
+  const Slot& slot = slots_[index % kCapacity];
+  auto version1 = slot.version.load(std::memory_order_acquire);
+  if ((version1 & 1) != 0) {
+    return false;
+  }
+  pose.time = slot.time.load(std::memory_order_relaxed);
+  pose.orientation.w = slot.data[0].load(std::memory_order_relaxed);
+  pose.orientation.x = slot.data[1].load(std::memory_order_relaxed);
+  pose.orientation.y = slot.data[2].load(std::memory_order_relaxed);
+  pose.orientation.z = slot.data[3].load(std::memory_order_relaxed);
+  pose.velocity.x = slot.data[4].load(std::memory_order_relaxed);
+  pose.velocity.y = slot.data[5].load(std::memory_order_relaxed);
+  pose.velocity.z = slot.data[6].load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto version2 = slot.version.load(std::memory_order_relaxed);
+  // Ячейку могли переписать уже следующим положением: это тоже отказ
+  return version1 == version2 &&
+         head_.load(std::memory_order_relaxed) - index <= kCapacity - 1;
+}
@@ -0,0 +1,73 @@
+#ifndef POSE_HISTORY_H
+#define POSE_HISTORY_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <glm/gtc/quaternion.hpp>
+
+/*! Кольцевая история положений шлема с метками времени. Пишет один поток
+(поток сенсоров), читать можно из любых потоков без блокировок: каждая ячейка
+защищена своим номером версии, и прочитанная во время перезаписи ячейка
+перечитывается. Время задаётся в микросекундах по часам steady_clock */
+class PoseHistory {
+ public:
+  /*! Одно положение шлема */
+  struct Pose {
+    int64_t time;  //!< Время измерения, мкс
+    glm::dquat orientation;  //!< Поворот из координат шлема в мировые
+    glm::dvec3 velocity;  //!< Угловая скорость в мировых координатах, рад/с
+  };
+
+  static const uint64_t kCapacity =
+      512;  //!< Размер истории (~0.25 с при 2000 измерений в секунду)
+
+  PoseHistory();
+  ~PoseHistory() = default;
+
+  /*! Добавить положение. Время положений должно расти. Вызывается только
+  потоком-писателем */
+  void Add(const Pose& pose);
+
+  /*! Забыть все сохранённые положения (например, после центрирования).
+  Вызывается только потоком-писателем */
+  void Clear();
+
+  /*! Выдать положение на заданное время. Между сохранёнными положениями
+  выполняется сферическая интерполяция, после последнего - экстраполяция по
+  угловой скорости (не дальше kMaxExtrapolation), до первого выдаётся первое
+  \param time время, мкс
+  \param orientation возвращаемый поворот
+  \return признак, что положение найдено. Если история пустая, то false */
+  bool GetPoseAt(int64_t time, glm::dquat& orientation) const;
+
+ private:
+  PoseHistory(const PoseHistory&) = delete;
+  PoseHistory(PoseHistory&&) = delete;
+  PoseHistory& operator=(const PoseHistory&) = delete;
+  PoseHistory& operator=(PoseHistory&&) = delete;
+
+  const int64_t kMaxExtrapolation =
+      50000;  //!< Максимальное время экстраполяции, мкс
+  static const int kReadAttempts =
+      4;  //!< Количество попыток чтения при перезаписи ячеек
+
+  /*! Ячейка истории */
+  struct Slot {
+    std::atomic<uint32_t> version;  //!< Нечётная версия - идёт запись
+    std::atomic<int64_t> time;
+    std::atomic<double> data[7];  //!< Поворот (w, x, y, z) и скорость
+  };
+
+  Slot slots_[kCapacity];
+  std::atomic<uint64_t> head_;  //!< Количество записанных положений
+  std::atomic<uint64_t> first_;  //!< Номер первого действительного положения
+
+  /*! Прочитать положение из ячейки
+  \param index номер положения
+  \param pose возвращаемое положение
+  \return признак успешного чтения (ячейку не перезаписали) */
+  bool ReadSlot(uint64_t index, Pose& pose) const;
+};
+
+#endif  // POSE_HISTORY_H
@@ -0,0 +1,55 @@
+#include "profiled_mutex.h"
+
+#ifdef PSVR_LOCK_PROFILING
+#include <string>
+
+namespace {
+
+/*! Выдать время в микросекундах между двумя моментами */
+int64_t ToMcs(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+}  // namespace
+
+
+ProfiledMutex::ProfiledMutex(const char* name)
+    : acquired_(Metrics::GetCounter("lock_" + std::string(name) + "_acquired")),
+      contended_(
+          Metrics::GetCounter("lock_" + std::string(name) + "_contended")),
+      wait_(Metrics::GetHistogram("lock_" + std::string(name) + "_wait_us")),
+      hold_(Metrics::GetHistogram("lock_" + std::string(name) + "_hold_us")) {}
+
+
+void ProfiledMutex::lock() {
+  if (!mutex_.try_lock()) {
+    auto start = std::chrono::steady_clock::now();
+    mutex_.lock();
+    locked_at_ = std::chrono::steady_clock::now();
+    contended_.Add();
+    wait_.Add(ToMcs(locked_at_ - start));
+  } else {
+    locked_at_ = std::chrono::steady_clock::now();
+    wait_.Add(0);
+  }
+  acquired_.Add();
+}
+
+
+bool ProfiledMutex::try_lock() {
+  if (!mutex_.try_lock()) {
+    contended_.Add();
+    return false;
+  }
+  locked_at_ = std::chrono::steady_clock::now();
+  acquired_.Add();
+  return true;
+}
+
+
+void ProfiledMutex::unlock() {
+  auto held = ToMcs(std::chrono::steady_clock::now() - locked_at_);
+  mutex_.unlock();
+  hold_.Add(held);
+}
+#endif
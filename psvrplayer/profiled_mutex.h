@@ -0,0 +1,64 @@
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <condition_variable>
+#include <mutex>
+
+#ifdef PSVR_LOCK_PROFILING
+#include <chrono>
+
+#include "metrics.h"
+
+/*! Мьютекс с профилированием конкуренции. Для каждой именованной блокировки
+в реестре метрик ведутся счётчики захватов lock_<имя>_acquired и захватов с
+ожиданием lock_<имя>_contended, гистограммы времени ожидания lock_<имя>_wait_us
+и удержания lock_<имя>_hold_us. Блокировки с одинаковым именем (например, в
+разных экземплярах класса) учитываются вместе. Сводка выводится вместе с
+остальными метриками, в том числе при завершении.
+
+Реестр метрик должен быть создан до мьютекса, поэтому глобальные мьютексы
+создаются при первом обращении (статическая переменная функции) */
+class ProfiledMutex {
+ public:
+  /*! Создать мьютекс
+  \param name имя блокировки для метрик */
+  explicit ProfiledMutex(const char* name);
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+ private:
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  ProfiledMutex(ProfiledMutex&&) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+  ProfiledMutex& operator=(ProfiledMutex&&) = delete;
+
+  std::mutex mutex_;
+  Metrics::Counter& acquired_;  //!< Количество захватов
+  Metrics::Counter& contended_;  //!< Количество захватов с ожиданием
+  LatencyHistogram& wait_;  //!< Время ожидания захвата, мкс
+  LatencyHistogram& hold_;  //!< Время удержания, мкс
+  std::chrono::steady_clock::time_point
+      locked_at_;  //!< Время захвата. Под блокировкой mutex_
+};
+
+/*! Условная переменная для ожидания на ProfiledMutex */
+using ProfiledConditionVariable = std::condition_variable_any;
+
+/*! Блокировка для ожидания на ProfiledConditionVariable */
+using ProfiledLock = std::unique_lock<ProfiledMutex>;
+
+#else
+/*! Без опции сборки PSVR_LOCK_PROFILING - обычный мьютекс, имя не
+используется */
+class ProfiledMutex : public std::mutex {
+ public:
+  explicit ProfiledMutex(const char*) {}
+};
+
+using ProfiledConditionVariable = std::condition_variable;
+using ProfiledLock = std::unique_lock<std::mutex>;
+#endif
+
+#endif  // PROFILED_MUTEX_H
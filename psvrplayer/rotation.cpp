@@ -1,5 +1,10 @@
 #include "rotation.h"
 
+#include <cmath>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
 #ifndef NDEBUG
 // #define DEBUG_POSITIONS
 // #define DEBUG_ANGLES
@@ -13,32 +18,31 @@
 #endif
 
 
-const double kPi = 3.1415926535897932384626433832795;
 const double kZeroVectorLength2 = 1.0e-25;
 
-Rotation::Rotation() {
-  Reset();
+Rotation::Rotation() : data_lock_("rotation_data"), pose_version_(0) {
   rotation_speedup_ = 1.0;
+  Reset();
 }
 
 void Rotation::Reset() {
-  std::lock_guard<std::mutex> l(data_lock_);
-  view_ = vec3d(0.0, 0.0, 1.0);
-  tip_ = vec3d(0.0, 1.0, 0.0);
+  std::lock_guard<ProfiledMutex> l(data_lock_);
+  orientation_ = quatd(1.0, 0.0, 0.0, 0.0);
+  Publish();
 }
 
 void Rotation::Rotate(double right1, double top1, double clock1) {
-  std::lock_guard<std::mutex> l(data_lock_);
-  auto right = -glm::cross(view_, tip_);
-  auto fv1 = glm::rotate(view_, glm::radians(right1), tip_);
-  auto rv1 = glm::rotate(right, glm::radians(right1), tip_);
-  auto fv2 = glm::rotate(fv1, glm::radians(-top1), rv1);
-  auto uv1 = glm::rotate(tip_, glm::radians(-top1), rv1);
-  //  auto rv2 = glm::rotate(rv1, glm::radians(-clock1), fv2);
-  auto uv2 = glm::rotate(uv1, glm::radians(-clock1), fv2);
-
-  view_ = glm::normalize(fv2);
-  tip_ = glm::normalize(uv2);
+  std::lock_guard<ProfiledMutex> l(data_lock_);
+  // Повороты заданы относительно осей самого шлема (x - вправо, y - вверх,
+  // z - вперёд), поэтому применяются справа
+  static const vec3d kRightAxis(1.0, 0.0, 0.0);
+  static const vec3d kTipAxis(0.0, 1.0, 0.0);
+  static const vec3d kViewAxis(0.0, 0.0, 1.0);
+  auto delta = glm::angleAxis(glm::radians(right1), kTipAxis) *
+               glm::angleAxis(glm::radians(-top1), kRightAxis) *
+               glm::angleAxis(glm::radians(-clock1), kViewAxis);
+  orientation_ = glm::normalize(orientation_ * delta);
+  Publish();
 
 #ifdef DEBUG_POSITIONS
   const size_t kPositionInterval = 1000;
@@ -46,9 +50,11 @@ void Rotation::Rotate(double right1, double top1, double clock1) {
   ++counter;
   if (counter >= kPositionInterval) {
     vec3d zenith(0.0, 1.0, 0.0);
-    std::cout << "Horizon: " << 90.0 - glm::degrees(glm::angle(zenith, view_))
+    auto view = orientation_ * kViewAxis;
+    auto tip = orientation_ * kTipAxis;
+    std::cout << "Horizon: " << 90.0 - glm::degrees(glm::angle(zenith, view))
               << " degr" << std::endl;
-    std::cout << "  Upper ? Zenith: " << glm::degrees(glm::angle(zenith, tip_))
+    std::cout << "  Upper ? Zenith: " << glm::degrees(glm::angle(zenith, tip))
               << " degr" << std::endl;
     counter = 0;
   }
@@ -80,88 +86,97 @@ void Rotation::Rotate(double right1, double top1, double clock1) {
 }
 
 
-void Rotation::GetSummRotation(glm::mat4& rot_mat) {
-  std::lock_guard<std::mutex> l(data_lock_);
-
-  vec3d base_view(0.0, 0.0, 1.0);
-  vec3d base_tip(0.0, 1.0, 0.0);
-  glm::dmat4 m(1);
-
-  auto fix_base_tip = base_tip;
-  const double kZeroAngle = 0.0;
-  double base_angle = kZeroAngle;
-  double tip_angle = kZeroAngle;
-  auto view_axis = glm::cross(base_view, view_);
-  auto view_axis_length2 = glm::length2(view_axis);
-  if (view_axis_length2 > kZeroVectorLength2) {
-    base_angle = RadAngle(view_axis, base_view, view_);
-    fix_base_tip = glm::rotate(base_tip, base_angle, view_axis);
+void Rotation::CorrectTilt(
+    double up_right, double up_top, double up_forward, double factor) {
+  std::lock_guard<ProfiledMutex> l(data_lock_);
+  auto measured = orientation_ * vec3d(up_right, up_top, up_forward);
+  if (glm::length2(measured) < kZeroVectorLength2) {
+    return;
   }
-  auto tip_axis = glm::cross(fix_base_tip, tip_);
-  auto tip_axis_length2 = glm::length2(tip_axis);
-  if (tip_axis_length2 > kZeroVectorLength2) {
-    tip_angle = RadAngle(tip_axis, fix_base_tip, tip_);
+  // Поворачиваем шлем вокруг горизонтальной оси так, чтобы измеренная
+  // вертикаль приблизилась к настоящей
+  vec3d zenith(0.0, 1.0, 0.0);
+  measured = glm::normalize(measured);
+  auto axis = glm::cross(measured, zenith);
+  auto axis_length = glm::length(axis);
+  if (axis_length * axis_length < kZeroVectorLength2) {
+    return;
   }
+  double angle = std::atan2(axis_length, glm::dot(measured, zenith)) * factor;
 
-  if (tip_angle != kZeroAngle) {
-    m = glm::rotate(m, tip_angle, tip_axis);
-  }
-  if (base_angle != kZeroAngle) {
-    m = glm::rotate(m, base_angle * rotation_speedup_, view_axis);
-  }
+  auto correction = glm::angleAxis(angle, axis * (1.0 / axis_length));
+  orientation_ = glm::normalize(correction * orientation_);
+  Publish();
+}
 
-  rot_mat = m;
+
+void Rotation::GetSummRotation(glm::mat4& rot_mat) {
+  GetRotation(ReadPose(), rot_mat);
 }
 
-void Rotation::SetRotationSpeedup(double speedup) {
-  std::lock_guard<std::mutex> l(data_lock_);
-  rotation_speedup_ = speedup;
+
+void Rotation::SetOrientation(const glm::dquat& pose) {
+  std::lock_guard<ProfiledMutex> l(data_lock_);
+  orientation_ = glm::normalize(pose);
+  Publish();
 }
 
 
-double Rotation::RadAngle(const vec3d& n, const vec3d& v1, const vec3d& v2) {
-  auto v1length2 = glm::length2(v1);
-  auto v2length2 = glm::length2(v2);
-  if (v1length2 < kZeroVectorLength2 || v2length2 < kZeroVectorLength2) {
-    // Угол между вектором и точкой всегда нулевой
-    return 0.0;
-  }
+void Rotation::GetOrientation(glm::dquat& pose) const { pose = ReadPose(); }
 
-  // Вектора и длины, для которых считается угол
-  auto p1 = v1;
-  auto p2 = v2;
-  auto p1length2 = v1length2;
-  auto p2length2 = v2length2;
-  auto nlength2 = glm::length2(n);
-  if (nlength2 > kZeroVectorLength2) {
-    p1 = glm::cross(n, v1);
-    p2 = glm::cross(n, v2);
-    p1length2 = glm::length2(p1);
-    p2length2 = glm::length2(p2);
-  }  // else ... При нулевой нормали считаем обычный угол между векторами
-
-  if (p1length2 < kZeroVectorLength2 || p2length2 < kZeroVectorLength2) {
-    // Один из векторов параллелен нормали. Фактически это вычисление угла между
-    // вектором и точкой
-    return 0.0;
-  }
 
-  auto raw_d = glm::dot(p1, p2);
-  auto cos2 = (raw_d * raw_d) / p1length2 / p2length2;
-
-  double angle = 0.0;
-  if (cos2 >= 1.0) {
-    angle = 0.0;
-  } else {
-    angle = glm::acos(2.0 * cos2 - 1.0) / 2.0;
-    if (raw_d < 0) {
-      angle = kPi - angle;
-    }
+void Rotation::GetRotation(const glm::dquat& pose, glm::mat4& rot_mat) const {
+  double speedup = rotation_speedup_.load(std::memory_order_relaxed);
+  if (speedup == 1.0) {
+    rot_mat = glm::mat4_cast(pose);
+    return;
   }
 
-  if (glm::dot(glm::cross(p1, p2), n) < 0) {
-    return -angle;
+  // Ускоряется только отклонение направления взгляда от базового (swing).
+  // Самовращение вокруг направления взгляда (twist) остаётся как есть
+  vec3d base_view(0.0, 0.0, 1.0);
+  auto swing = glm::rotation(base_view, pose * base_view);
+  auto twist = pose * glm::conjugate(swing);
+  vec3d swing_axis(swing.x, swing.y, swing.z);
+  auto swing_sin = glm::length(swing_axis);
+  if (swing_sin * swing_sin > kZeroVectorLength2) {
+    double swing_angle = 2.0 * std::atan2(swing_sin, swing.w);
+    swing = glm::angleAxis(
+        swing_angle * speedup, swing_axis * (1.0 / swing_sin));
   }
+  rot_mat = glm::mat4_cast(twist * swing);
+}
+
+void Rotation::SetRotationSpeedup(double speedup) {
+  rotation_speedup_.store(speedup, std::memory_order_relaxed);
+}
+
+
+void Rotation::Publish() {
+  // Писатель один (под data_lock_), читатели перечитывают положение, если
+  // версия поменялась за время чтения
+  auto version = pose_version_.load(std::memory_order_relaxed);
+  pose_version_.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  pose_[0].store(orientation_.w, std::memory_order_relaxed);
+  pose_[1].store(orientation_.x, std::memory_order_relaxed);
+  pose_[2].store(orientation_.y, std::memory_order_relaxed);
+  pose_[3].store(orientation_.z, std::memory_order_relaxed);
+  pose_version_.store(version + 2, std::memory_order_release);
+}
+
 
-  return angle;
+Rotation::quatd Rotation::ReadPose() const {
+  quatd pose;
+  uint32_t version1, version2;
+  do {
+    version1 = pose_version_.load(std::memory_order_acquire);
+    pose.w = pose_[0].load(std::memory_order_relaxed);
+    pose.x = pose_[1].load(std::memory_order_relaxed);
+    pose.y = pose_[2].load(std::memory_order_relaxed);
+    pose.z = pose_[3].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    version2 = pose_version_.load(std::memory_order_relaxed);
+  } while ((version1 & 1) != 0 || version1 != version2);
+  return pose;
 }
@@ -1,12 +1,19 @@
 #ifndef ROTATION_H
 #define ROTATION_H
 
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/vector_angle.hpp>
 
+#include "profiled_mutex.h"
 
+
+/*! Расчёт положения шлема. Положение хранится нормализованным кватернионом и
+меняется потоком сенсоров. Последнее положение публикуется так, что поток
+отрисовки читает его без блокировок и никогда не задерживает поток сенсоров */
 class Rotation {
  public:
   Rotation();
@@ -23,12 +30,37 @@ class Rotation {
   \param clock кручение шлема по часовой стрелке (-против часовой) */
   void Rotate(double right, double top, double clock);
 
+  /*! Подтянуть наклон шлема (тангаж и крен) к направлению вертикали,
+  измеренному акселерометром. Поворот вокруг вертикали не меняется.
+  Направление задаётся в координатах самого шлема
+  \param up_right проекция вертикали на правую ось шлема
+  \param up_top проекция вертикали на верхнюю ось шлема
+  \param up_forward проекция вертикали на переднюю ось шлема
+  \param factor доля исправляемого отклонения, от 0 до 1 */
+  void CorrectTilt(
+      double up_right, double up_top, double up_forward, double factor);
+
   /*! Выдать суммарное (общее) вращение шлема относительно базового расположения
   (смотрим вперёд горизонтально). Умножая эту матрицу на базовый вектор
   получаем вектор текущего направления
   \param rot_mat выдаваемая матрица поворота */
   void GetSummRotation(glm::mat4& rot_mat);
 
+  /*! Установить поворот шлема напрямую (например, для искусственного шлема)
+  \param pose поворот из координат шлема в мировые */
+  void SetOrientation(const glm::dquat& pose);
+
+  /*! Выдать текущий поворот шлема из его координат в мировые. Не блокирует
+  поток сенсоров
+  \param pose выдаваемый поворот */
+  void GetOrientation(glm::dquat& pose) const;
+
+  /*! Построить матрицу вращения (как в GetSummRotation) для заданного поворота
+  шлема с учётом ускоренного вращения
+  \param pose поворот шлема, например, из истории положений
+  \param rot_mat выдаваемая матрица поворота */
+  void GetRotation(const glm::dquat& pose, glm::mat4& rot_mat) const;
+
   /*! Установить ускоренное/замедленное вращение: поворот шлема на фиксированный
   угол приводит к кратному увеличению угла. Прим.: поворот набок не ускоряется
   \param rotation_speed ускорение вращения, в штуках. Значение 1.0 - без
@@ -36,28 +68,30 @@ class Rotation {
   void SetRotationSpeedup(double speedup);
 
  private:
-  Rotation(const Rotation&) = default;
-  Rotation(Rotation&&) = default;
-  Rotation& operator=(const Rotation&) = default;
-  Rotation& operator=(Rotation&&) = default;
+  Rotation(const Rotation&) = delete;
+  Rotation(Rotation&&) = delete;
+  Rotation& operator=(const Rotation&) = delete;
+  Rotation& operator=(Rotation&&) = delete;
 
   using vec3d = glm::vec<3, double, glm::defaultp>;
+  using quatd = glm::dquat;
+
+  quatd orientation_;  //!< Поворот из координат шлема в мировые. Под
+                       //!< блокировкой data_lock_
+  ProfiledMutex data_lock_;  //!< Блокировка изменения положения
+
+  // Опубликованное положение для чтения без блокировок (seqlock). Нечётный
+  // номер версии - идёт запись
+  std::atomic<uint32_t> pose_version_;  //!< Номер версии положения
+  std::atomic<double> pose_[4];  //!< Компоненты кватерниона: w, x, y, z
+  std::atomic<double> rotation_speedup_;  //!< Коэффициент ускоренного вращения
+
+  /*! Опубликовать текущее положение для читателей. Вызывается под блокировкой
+  data_lock_ */
+  void Publish();
 
-  vec3d view_;  //!< Вектор куда смотрит сам шлем (мировые координаты)
-  vec3d tip_;  //!< Вектор куда смотрит верх шлема (мировые координаты)
-  double rotation_speedup_;  //!< Коэффициент ускоренного вращения
-  std::mutex data_lock_;
-
-  /*! Сосчитаем угол поворота между векторами в заданной плоскости. Поворот
-  считается по часовой стрелки с точки зрения вектора нормали. Система
-  координат: х - вправо, y - вверх, z - вперёд от нас \param n плоскость, в
-  которой считаются углы. Задаётся нормалью \param v1 вектор от которого
-  считается поворот \param v2 вектор в сторону которого считается поворот. Если
-  вектор нормали очень короткий или вектора v1 или v2параллельный нормали,
-  то вычисляется обычный угол между векторами
-  (без привязки к плоскости) - и в этом случае он всегда неотрицательный.
-  \return угол поворота в радианах (от -pi до +pi) */
-  double RadAngle(const vec3d& n, const vec3d& v1, const vec3d& v2);
+  /*! Выдать последнее опубликованное положение. Не блокирует писателя */
+  quatd ReadPose() const;
 };
 
 #endif  // ROTATION_H
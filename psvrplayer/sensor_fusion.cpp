@@ -0,0 +1,192 @@
+#include "sensor_fusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "config_file.h"
+#include "metrics.h"
+
+
+SensorFusion::SensorFusion()
+    : right_velo_(0.0),
+      top_velo_(0.0),
+      clock_velo_(0.0),
+      velo_lock_("helmet_velo"),
+      bias_updated_(false),
+      window_(),
+      last_pose_time_(0),
+      smoothing_latency_(Metrics::GetHistogram("smoothing_latency_us")) {
+  center_view_flag_ = true;
+  last_sensor_time_ = std::numeric_limits<uint64_t>::max();
+
+  Config::GetFusionOptions(
+      &tilt_gain_, &accel_tolerance_, &bias_tracking_, nullptr);
+
+  double min_cutoff, beta, speed_cutoff;
+  Config::GetSmoothingOptions(&min_cutoff, &beta, &speed_cutoff);
+  smoothing_.SetParameters(min_cutoff, beta, speed_cutoff);
+}
+
+
+void SensorFusion::SetBias(double right, double top, double clock) {
+  std::lock_guard<ProfiledMutex> vl(velo_lock_);
+  right_velo_ = right;
+  top_velo_ = top;
+  clock_velo_ = clock;
+}
+
+
+bool SensorFusion::GetBias(double* right, double* top, double* clock) {
+  std::lock_guard<ProfiledMutex> vl(velo_lock_);
+  *right = right_velo_;
+  *top = top_velo_;
+  *clock = clock_velo_;
+  return bias_updated_;
+}
+
+
+void SensorFusion::ProcessBatch(const SensorsSample* samples, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    const SensorsSample& sample = samples[i];
+    if (last_sensor_time_ == std::numeric_limits<uint64_t>::max()) {
+      last_sensor_time_ = sample.mcs_time;
+      continue;
+    }
+    double ims = (sample.mcs_time - last_sensor_time_) * 0.001;
+    last_sensor_time_ = sample.mcs_time;
+
+    // Скорость без дрейфа сглаживается в градусах в секунду
+    std::unique_lock<ProfiledMutex> vl(velo_lock_);
+    double velocity[3] = {(sample.to_right - right_velo_) * 1000.0,
+        (sample.to_top - top_velo_) * 1000.0,
+        (sample.to_clockwork - clock_velo_) * 1000.0};
+    vl.unlock();
+    smoothing_.Filter(velocity, ims * 0.001);
+    if (smoothing_.IsEnabled()) {
+      smoothing_latency_.Add(int64_t(smoothing_.GetLatency() * 1.0e6));
+    }
+    double right_da = velocity[0] * ims * 0.001;
+    double top_da = velocity[1] * ims * 0.001;
+    double roll_da = velocity[2] * ims * 0.001;
+
+    double g = std::sqrt(sample.accel_right * sample.accel_right +
+                         sample.accel_top * sample.accel_top +
+                         sample.accel_forward * sample.accel_forward);
+    if (bias_tracking_) {
+      TrackBias(sample);
+    }
+
+    bool cv = center_view_flag_.exchange(false);
+    if (cv) {
+      rotation_.Reset();
+      history_.Clear();
+      smoothing_.Reset();
+      continue;
+    }
+    rotation_.Rotate(right_da, top_da, roll_da);
+
+    // Коррекция наклона: в покое акселерометр показывает вертикаль. При
+    // заметном собственном ускорении шлема показания не используем
+    if (tilt_gain_ > 0.0) {
+      if (std::abs(g - 1.0) < accel_tolerance_) {
+        double factor = std::min(1.0, tilt_gain_ * ims * 0.001);
+        rotation_.CorrectTilt(sample.accel_right, sample.accel_top,
+            sample.accel_forward, factor);
+      }
+    }
+
+    // Угловая скорость в осях шлема (x - вправо, y - вверх, z - вперёд) в
+    // рад/с, как в Rotation::Rotate, переводится в мировые координаты
+    PoseHistory::Pose pose;
+    pose.time = sample.host_time;
+    rotation_.GetOrientation(pose.orientation);
+    const double kRadiansPerSecond = glm::radians(1.0) * 1000.0;
+    glm::dvec3 local(-top_da, right_da, -roll_da);
+    pose.velocity =
+        pose.orientation * (local * (kRadiansPerSecond / std::max(ims, 0.001)));
+    history_.Add(pose);
+    last_pose_time_.store(sample.host_time, std::memory_order_relaxed);
+  }
+}
+
+
+void SensorFusion::TrackBias(const SensorsSample& sample) {
+  const double gyro[3] = {sample.to_right, sample.to_top, sample.to_clockwork};
+  const double accel[3] = {
+      sample.accel_right, sample.accel_top, sample.accel_forward};
+  for (int i = 0; i < 3; ++i) {
+    window_.gyro_summ[i] += gyro[i];
+    window_.gyro_summ2[i] += gyro[i] * gyro[i];
+    window_.accel_summ[i] += accel[i];
+    window_.accel_summ2[i] += accel[i] * accel[i];
+  }
+  ++window_.count;
+  if (window_.count < kStationarySamples) {
+    return;
+  }
+
+  // Окно набрано: шлем неподвижен, если разброс всех показаний мал. Разброс
+  // ускорения считается по осям, поэтому наклон шлема (смена направления
+  // вертикали при том же модуле) окно отбрасывает
+  double n = double(window_.count);
+  double mean[3];
+  bool stationary = true;
+  for (int i = 0; i < 3; ++i) {
+    mean[i] = window_.gyro_summ[i] / n;
+    double var = window_.gyro_summ2[i] / n - mean[i] * mean[i];
+    stationary = stationary &&
+                 var < kStationaryGyroDeviation * kStationaryGyroDeviation;
+    double accel_mean = window_.accel_summ[i] / n;
+    double accel_var = window_.accel_summ2[i] / n - accel_mean * accel_mean;
+    stationary = stationary && accel_var < kStationaryAccelDeviation *
+                                               kStationaryAccelDeviation;
+  }
+  window_ = StationaryWindow();
+  if (!stationary) {
+    return;
+  }
+
+  // Медленный ровный поворот вокруг вертикали не меняет ни разброс скорости,
+  // ни ускорение. Поэтому окно, среднее которого далеко от текущего дрейфа,
+  // считается движением, а не дрейфом
+  std::lock_guard<ProfiledMutex> vl(velo_lock_);
+  const double bias[3] = {right_velo_, top_velo_, clock_velo_};
+  for (int i = 0; i < 3; ++i) {
+    if (std::abs(mean[i] - bias[i]) > kMaxBiasDeviation) {
+      return;
+    }
+  }
+  right_velo_ += (mean[0] - right_velo_) * kBiasUpdateFactor;
+  top_velo_ += (mean[1] - top_velo_) * kBiasUpdateFactor;
+  clock_velo_ += (mean[2] - clock_velo_) * kBiasUpdateFactor;
+  bias_updated_ = true;
+}
+
+
+void SensorFusion::CenterView() { center_view_flag_ = true; }
+
+void SensorFusion::GetViewPoint(glm::mat4& rot_mat) {
+  // Центрирование выполняет поток сенсоров вместе со сбросом истории
+  rotation_.GetSummRotation(rot_mat);
+}
+
+void SensorFusion::GetViewPointAt(int64_t mcs, glm::mat4& rot_mat) {
+  glm::dquat pose;
+  if (history_.GetPoseAt(mcs, pose)) {
+    rotation_.GetRotation(pose, rot_mat);
+  } else {
+    rotation_.GetSummRotation(rot_mat);
+  }
+}
+
+int64_t SensorFusion::GetLastPoseTime() const {
+  return last_pose_time_.load(std::memory_order_relaxed);
+}
+
+void SensorFusion::SetRotationSpeedup(double speedup) {
+  rotation_.SetRotationSpeedup(speedup);
+}
@@ -0,0 +1,128 @@
+#ifndef SENSOR_FUSION_H
+#define SENSOR_FUSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "latency_histogram.h"
+#include "one_euro_filter.h"
+#include "pose_history.h"
+#include "profiled_mutex.h"
+#include "rotation.h"
+#include "sensors_packet.h"
+
+
+/*! Расчёт положения шлема по измерениям сенсоров: вычитание дрейфа,
+сглаживание, поворот, коррекция наклона и история положений. Измерения
+обрабатывает один поток (поток сенсоров), положение запрашивается из любых
+потоков */
+class SensorFusion {
+ public:
+  /*! Создать расчёт с настройками из конфигурации (Fusion) */
+  SensorFusion();
+
+  /*! Задать дрейф гироскопа (из калибровки). Функция потокобезопасная
+  \param right скорость дрейфа вправо, градусы в миллисекунду
+  \param top скорость дрейфа вверх, градусы в миллисекунду
+  \param clock скорость дрейфа по часовой стрелке, градусы в миллисекунду */
+  void SetBias(double right, double top, double clock);
+
+  /*! Выдать текущий дрейф гироскопа. Функция потокобезопасная
+  \param right возвращаемая скорость дрейфа вправо
+  \param top возвращаемая скорость дрейфа вверх
+  \param clock возвращаемая скорость дрейфа по часовой стрелке
+  \return true, если дрейф уточнялся во время просмотра */
+  bool GetBias(double* right, double* top, double* clock);
+
+  /*! Обработать пачку измерений. Вызывается только потоком сенсоров
+  \param samples измерения, упорядоченные по времени
+  \param count количество измерений */
+  void ProcessBatch(const SensorsSample* samples, size_t count);
+
+  /*! Запросить центрирование. Выполняется потоком сенсоров на следующем
+  измерении вместе со сбросом истории и сглаживания */
+  void CenterView();
+
+  /*! Выдать последнее положение
+  \param rot_mat возвращаемая матрица поворота */
+  void GetViewPoint(glm::mat4& rot_mat);
+
+  /*! Выдать положение на заданное время. Без истории выдаётся последнее
+  \param mcs время по часам steady_clock, мкс
+  \param rot_mat возвращаемая матрица поворота */
+  void GetViewPointAt(int64_t mcs, glm::mat4& rot_mat);
+
+  /*! Выдать время последнего измерения
+  \return время по часам компьютера, мкс. 0 - измерений ещё не было */
+  int64_t GetLastPoseTime() const;
+
+  /*! Задать ускорение поворота
+  \param speedup множитель угла поворота */
+  void SetRotationSpeedup(double speedup);
+
+ private:
+  SensorFusion(const SensorFusion&) = delete;
+  SensorFusion(SensorFusion&&) = delete;
+  SensorFusion& operator=(const SensorFusion&) = delete;
+  SensorFusion& operator=(SensorFusion&&) = delete;
+
+
+  std::atomic_bool center_view_flag_;
+  uint64_t last_sensor_time_;
+
+  double right_velo_;  //!< Скорость "дрейфа" шлема вправо (из калибровки)
+  double top_velo_;  //!< Скорость "дрейфа" шлема вверх (из калибровки)
+  double clock_velo_;  //!< Скорость "дрейфа" шлема по часовой стрелке (из
+                       //!< калибровки)
+  ProfiledMutex velo_lock_;
+
+  double tilt_gain_;  //!< Скорость коррекции наклона по акселерометру, 1/с
+  double accel_tolerance_;  //!< Допуск модуля ускорения от 1 g для коррекции
+
+  /*! Статистика измерений за окно для определения неподвижности шлема.
+  Используется только в потоке чтения сенсоров */
+  struct StationaryWindow {
+    size_t count;  //!< Количество измерений в окне
+    double gyro_summ[3];  //!< Суммы скоростей по осям
+    double gyro_summ2[3];  //!< Суммы квадратов скоростей по осям
+    double accel_summ[3];  //!< Суммы ускорений по осям
+    double accel_summ2[3];  //!< Суммы квадратов ускорений по осям
+  };
+
+  const size_t kStationarySamples =
+      500;  //!< Размер окна неподвижности, измерений (~0.25 с)
+  const double kStationaryGyroDeviation =
+      0.0005;  //!< Допустимое СКО скорости в покое, градусы в миллисекунду
+  const double kStationaryAccelDeviation =
+      0.01;  //!< Допустимое СКО ускорения по каждой оси в покое, g
+  const double kMaxBiasDeviation =
+      0.0003;  //!< Наибольшее отличие среднего окна от текущего дрейфа,
+               //!< градусы в миллисекунду (0.3 градуса в секунду)
+  const double kBiasUpdateFactor =
+      0.02;  //!< Вес нового окна при уточнении дрейфа
+
+  bool bias_tracking_;  //!< Уточнять дрейф во время просмотра
+  bool bias_updated_;  //!< Признак, что дрейф уточнялся. Под velo_lock_
+  StationaryWindow window_;  //!< Текущее окно неподвижности
+
+  /*! Учесть измерение для оценки дрейфа. При неподвижном шлеме за всё окно
+  дрейф подтягивается к среднему значению скорости. Окна, среднее которых
+  отличается от дрейфа больше kMaxBiasDeviation, не учитываются: так
+  уточняется только небольшой уход дрейфа от калибровки */
+  void TrackBias(const SensorsSample& sample);
+
+  OneEuroFilter smoothing_;  //!< Сглаживание угловой скорости
+
+  std::atomic<int64_t> last_pose_time_;  //!< Время последнего измерения по
+                                        //!< часам компьютера, мкс. 0 - нет
+  LatencyHistogram& smoothing_latency_;  //!< Задержка, вносимая сглаживанием
+
+  Rotation rotation_;  //!< Математика для расчёта вращений
+  PoseHistory history_;  //!< История положений для запросов на время
+};
+
+
+#endif  // SENSOR_FUSION_H
@@ -0,0 +1,117 @@
+#include "sensor_telemetry.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "metrics.h"
+
+
+SensorTelemetry::SensorTelemetry()
+    : total_(),
+      period_(),
+      start_time_(-1),
+      period_start_(0),
+      last_host_time_(0),
+      last_device_time_(0),
+      sample_interval_(0),
+      jitter_(Metrics::GetHistogram("sensors_jitter_us")),
+      period_jitter_("sensors_period_jitter_us") {}
+
+
+void SensorTelemetry::OnPacket(int64_t host_time, uint64_t device_time) {
+  if (start_time_ < 0) {
+    start_time_ = host_time;
+    period_start_ = host_time;
+  } else {
+    // Неравномерность доставки: насколько интервал прихода пакета отличается
+    // от интервала между измерениями по часам шлема
+    int64_t host_delta = host_time - last_host_time_;
+    int64_t device_delta = int64_t(device_time - last_device_time_);
+    int64_t jitter = std::llabs(host_delta - device_delta);
+    jitter_.Add(jitter);
+    period_jitter_.Add(jitter);
+  }
+  last_host_time_ = host_time;
+  last_device_time_ = device_time;
+  ++period_.packets;
+
+  CheckPeriod(host_time);
+}
+
+
+void SensorTelemetry::OnSampleInterval(int64_t interval) {
+  if (interval <= 0) {
+    return;
+  }
+  if (sample_interval_ == 0) {
+    sample_interval_ = interval;
+    return;
+  }
+  if (interval > sample_interval_ * kGapFactor) {
+    ++period_.gaps;
+    period_.lost_samples +=
+        uint64_t((interval + sample_interval_ / 2) / sample_interval_ - 1);
+    return;
+  }
+  sample_interval_ += (interval - sample_interval_) / kIntervalFactor;
+}
+
+
+void SensorTelemetry::OnClockReset() { ++period_.clock_resets; }
+
+
+void SensorTelemetry::OnMalformed() { ++period_.malformed; }
+
+
+void SensorTelemetry::OnTimeout() { ++period_.timeouts; }
+
+
+void SensorTelemetry::OnError() { ++period_.errors; }
+
+
+void SensorTelemetry::Report() {
+  Add(total_, period_);
+  period_ = Counters();
+  int64_t duration = start_time_ < 0 ? 0 : last_host_time_ - start_time_;
+  Print("Sensors total", total_, jitter_, duration);
+}
+
+
+void SensorTelemetry::Add(Counters& to, const Counters& from) {
+  to.packets += from.packets;
+  to.timeouts += from.timeouts;
+  to.malformed += from.malformed;
+  to.errors += from.errors;
+  to.gaps += from.gaps;
+  to.lost_samples += from.lost_samples;
+  to.clock_resets += from.clock_resets;
+}
+
+
+void SensorTelemetry::Print(const char* title, const Counters& counters,
+    const LatencyHistogram& jitter, int64_t duration) {
+  double rate = duration > 0 ? counters.packets * 1000000.0 / duration : 0.0;
+  char rate_text[32];
+  std::snprintf(rate_text, sizeof(rate_text), "%.1f", rate);
+  std::cerr << title << ": " << counters.packets << " packets (" << rate_text
+            << "/s), "
+            << counters.timeouts << " timeouts, " << counters.malformed
+            << " malformed, " << counters.errors << " errors, " << counters.gaps
+            << " gaps (" << counters.lost_samples << " samples lost), "
+            << counters.clock_resets << " clock resets, jitter p99 <= "
+            << jitter.GetPercentile(0.99) << " us" << std::endl;
+}
+
+
+void SensorTelemetry::CheckPeriod(int64_t now) {
+  int64_t duration = now - period_start_;
+  if (duration < kReportPeriod) {
+    return;
+  }
+  Print("Sensors", period_, period_jitter_, duration);
+  Add(total_, period_);
+  period_ = Counters();
+  period_jitter_.Reset();
+  period_start_ = now;
+}
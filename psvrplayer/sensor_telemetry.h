@@ -0,0 +1,91 @@
+#ifndef SENSOR_TELEMETRY_H
+#define SENSOR_TELEMETRY_H
+
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+/*! Телеметрия потока данных сенсоров шлема: частота пакетов, таймауты,
+испорченные пакеты, пропуски по часам шлема и неравномерность прихода пакетов.
+Сводка за период выводится в std::cerr по ходу работы, общая - по запросу.
+Обновляется только в потоке чтения сенсоров */
+class SensorTelemetry {
+ public:
+  SensorTelemetry();
+
+  /*! Учесть пришедший пакет
+  \param host_time время прихода пакета по часам компьютера, мкс
+  \param device_time время первого измерения пакета по часам шлема, мкс */
+  void OnPacket(int64_t host_time, uint64_t device_time);
+
+  /*! Учесть интервал между соседними измерениями по часам шлема
+  \param interval интервал, мкс */
+  void OnSampleInterval(int64_t interval);
+
+  /*! Учесть сброс часов шлема (слишком большой скачок времени) */
+  void OnClockReset();
+
+  /*! Учесть пакет неожиданного размера */
+  void OnMalformed();
+
+  /*! Учесть запрос чтения, завершившийся по таймауту */
+  void OnTimeout();
+
+  /*! Учесть ошибку чтения */
+  void OnError();
+
+  /*! Вывести общую сводку за всё время работы в std::cerr */
+  void Report();
+
+ private:
+  SensorTelemetry(const SensorTelemetry&) = delete;
+  SensorTelemetry(SensorTelemetry&&) = delete;
+  SensorTelemetry& operator=(const SensorTelemetry&) = delete;
+  SensorTelemetry& operator=(SensorTelemetry&&) = delete;
+
+  const int64_t kReportPeriod = 10000000;  //!< Период вывода сводки, мкс
+  const double kGapFactor =
+      1.5;  //!< Во сколько раз интервал больше обычного, чтобы считаться
+            //!< пропуском
+  const int64_t kIntervalFactor =
+      64;  //!< Инерционность оценки обычного интервала измерений
+
+  /*! Счётчики событий */
+  struct Counters {
+    uint64_t packets;  //!< Пришедшие пакеты
+    uint64_t timeouts;  //!< Таймауты чтения
+    uint64_t malformed;  //!< Пакеты неожиданного размера
+    uint64_t errors;  //!< Ошибки чтения
+    uint64_t gaps;  //!< Пропуски по часам шлема
+    uint64_t lost_samples;  //!< Оценка пропущенных измерений
+    uint64_t clock_resets;  //!< Сбросы часов шлема
+  };
+
+  Counters total_;  //!< Счётчики за всё время
+  Counters period_;  //!< Счётчики за текущий период вывода
+  int64_t start_time_;  //!< Время первого пакета, мкс. -1 - пакетов не было
+  int64_t period_start_;  //!< Начало текущего периода вывода, мкс
+  int64_t last_host_time_;  //!< Время прихода прошлого пакета, мкс
+  uint64_t last_device_time_;  //!< Время шлема прошлого пакета, мкс
+  int64_t sample_interval_;  //!< Обычный интервал измерений, мкс. 0 - нет
+  LatencyHistogram& jitter_;  //!< Отклонение интервалов прихода пакетов от
+                              //!< интервалов по часам шлема за всё время
+  LatencyHistogram period_jitter_;  //!< То же за текущий период вывода
+
+  /*! Добавить счётчики к другим */
+  static void Add(Counters& to, const Counters& from);
+
+  /*! Вывести сводку
+  \param title заголовок сводки
+  \param counters счётчики
+  \param jitter неравномерность прихода пакетов за то же время
+  \param duration длительность, за которую собраны счётчики, мкс */
+  void Print(const char* title, const Counters& counters,
+      const LatencyHistogram& jitter, int64_t duration);
+
+  /*! Вывести сводку за период, если он закончился
+  \param now текущее время, мкс */
+  void CheckPeriod(int64_t now);
+};
+
+#endif  // SENSOR_TELEMETRY_H
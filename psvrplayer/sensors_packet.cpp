@@ -0,0 +1,50 @@
+#include "sensors_packet.h"
+
+
+const double kVelocityScale =
+    0.0000625;  //!< Перевод показаний гироскопа в градусы в миллисекунду
+const double kGravityScale =
+    1.0 / 16384.0;  //!< Перевод показаний акселерометра в g
+
+
+bool SensorsPacket::IsValidSize(int length) {
+  // Прим.: может передаваться завершающий 0 вне запрашиваемого пакета
+  return (length == kPacketSize) || (length == kPacketSize + 1);
+}
+
+
+uint32_t SensorsPacket::GetDeviceTime(const unsigned char* buffer, int index) {
+  return uint32_t(read_int32(buffer, kFirstSampleOffset + index * kSampleSize));
+}
+
+
+void SensorsPacket::DecodeSample(
+    const unsigned char* buffer, int index, SensorsSample& sample) {
+  const int base = kFirstSampleOffset + index * kSampleSize;
+  sample.to_right = -(read_int16(buffer, base + 4) * kVelocityScale);
+  sample.to_top = (read_int16(buffer, base + 6) * kVelocityScale);
+  sample.to_clockwork = -(read_int16(buffer, base + 8) * kVelocityScale);
+  // Оси акселерометра совпадают с осями гироскопа
+  sample.accel_top = read_int16(buffer, base + 10) * kGravityScale;
+  sample.accel_right = read_int16(buffer, base + 12) * kGravityScale;
+  sample.accel_forward = read_int16(buffer, base + 14) * kGravityScale;
+}
+
+
+bool SensorsPacket::IsWorn(const unsigned char* buffer) {
+  return (buffer[kStatusOffset] & kWornFlag) != 0;
+}
+
+
+int16_t SensorsPacket::read_int16(const unsigned char* buffer, int offset) {
+  int16_t v;
+  v = buffer[offset];
+  v |= buffer[offset + 1] << 8;
+  return v;
+}
+
+
+int32_t SensorsPacket::read_int32(const unsigned char* buffer, int offset) {
+  return (buffer[offset + 0] << 0) | (buffer[offset + 1] << 8) |
+         (buffer[offset + 2] << 16) | (buffer[offset + 3] << 24);
+}
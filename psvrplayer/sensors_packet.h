@@ -0,0 +1,72 @@
+#ifndef SENSORS_PACKET_H
+#define SENSORS_PACKET_H
+
+#include <cstdint>
+
+
+/*! Одно измерение сенсоров шлема. Скорость поворота измеряется в градусах в
+миллисекунду */
+struct SensorsSample {
+  double to_right;  //!< Скорость поворота вправо
+  double to_top;  //!< Скорость поворота вверх
+  double to_clockwork;  //!< Скорость поворота по часовой стрелке
+  double accel_right;  //!< Ускорение вдоль правой оси шлема, в g
+  double accel_top;  //!< Ускорение вдоль верхней оси шлема, в g
+  double accel_forward;  //!< Ускорение вдоль передней оси шлема, в g
+  uint64_t mcs_time;  //!< Время измерения по часам шлема в микросекундах
+                      //!< (всегда увеличивается)
+  int64_t host_time;  //!< Время измерения по часам компьютера (steady_clock)
+                      //!< в микросекундах. При ускоренном воспроизведении
+                      //!< записи - время её показа
+};
+
+
+/*! Разбор пакета с данными сенсоров шлема PSVR. Часы измерений ведёт
+PsvrHelmetHid, здесь только раскладка пакета */
+class SensorsPacket {
+ public:
+  static const int kPacketSize = 64;  //!< Размер пакета с данными сенсоров
+  static const int kSamplesPerPacket = 2;  //!< Измерений в одном пакете
+
+  /*! Проверить размер пришедших данных
+  \param length размер данных
+  \return true, если это пакет сенсоров */
+  static bool IsValidSize(int length);
+
+  /*! Выдать метку времени измерения по часам шлема
+  \param buffer данные пакета
+  \param index номер измерения в пакете
+  \return 32-битный счётчик микросекунд шлема */
+  static uint32_t GetDeviceTime(const unsigned char* buffer, int index);
+
+  /*! Разобрать скорости и ускорения измерения. Время измерения не
+  заполняется
+  \param buffer данные пакета
+  \param index номер измерения в пакете
+  \param sample возвращаемое измерение */
+  static void DecodeSample(
+      const unsigned char* buffer, int index, SensorsSample& sample);
+
+  /*! Выдать признак датчика приближения
+  \param buffer данные пакета
+  \return true, если датчик видит голову */
+  static bool IsWorn(const unsigned char* buffer);
+
+ private:
+  static const int kFirstSampleOffset = 16;  //!< Смещение первого измерения
+  static const int kSampleSize = 16;  //!< Размер одного измерения в пакете
+  static const int kStatusOffset = 8;  //!< Смещение байта состояния шлема
+  static const unsigned char kWornFlag =
+      0x01;  //!< Флаг байта состояния: шлем надет
+
+  /*! Функция вычитывания из буфера 16-битного значения
+  \param buffer буфер с данными
+  \param offset смещение числа
+  \return число из буфера */
+  static int16_t read_int16(const unsigned char* buffer, int offset);
+
+  static int32_t read_int32(const unsigned char* buffer, int offset);
+};
+
+
+#endif  // SENSORS_PACKET_H
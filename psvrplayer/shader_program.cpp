@@ -1,7 +1,9 @@
 #include "shader_program.h"
 
 #include <cassert>
+#include <cstdint>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -15,11 +17,138 @@
 #include <GLFW/glfw3.h>
 // clang-format on
 
+#include "home-dir.h"
+
+
+const uint32_t kBinaryCacheMagic = 0x42565350;  //!< Метка файла кэша "PSVB"
+const uint32_t kMaxBinaryCacheSize =
+    16 * 1024 * 1024;  //!< Максимальный размер бинарной программы в кэше
+
+
+/*! Получить имя файла кэша бинарной программы. Имя строится из хэша исходных
+текстов шейдеров, производителя, модели и версии драйвера, поэтому при смене
+шейдеров или драйвера используется новый файл.
+\return полное имя файла кэша. Если кэширование невозможно (драйвер не умеет
+выдавать бинарные программы, нет папки для данных), то пустая строка */
+std::string GetBinaryCacheName(const std::string& vs, const std::string& fs) {
+  if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) {
+    return std::string();
+  }
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats <= 0) {
+    return std::string();
+  }
+
+  auto dir = HomeDirLibrary::GetDataDir();
+  if (dir.empty()) {
+    return std::string();
+  }
+
+  // FNV-1a хэш по всем составляющим ключа. Составляющие разделены нулём
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](const std::string& str) {
+    for (unsigned char c : str) {
+      hash = (hash ^ c) * 1099511628211ULL;
+    }
+    hash = hash * 1099511628211ULL;
+  };
+  auto gl_str = [](GLenum name) {
+    auto s = reinterpret_cast<const char*>(glGetString(name));
+    return std::string(s ? s : "");
+  };
+  add(vs);
+  add(fs);
+  add(gl_str(GL_VENDOR));
+  add(gl_str(GL_RENDERER));
+  add(gl_str(GL_VERSION));
+
+  std::stringstream name;
+  name << dir << "/psvrplayer-shader-" << std::hex << std::setw(16)
+       << std::setfill('0') << hash << ".bin";
+  return name.str();
+}
+
+
+/*! Загрузить программу из файла кэша.
+\param fname имя файла кэша
+\param program возвращаемый идентификатор gl программы
+\return признак успешной загрузки. При любой ошибке (нет файла, испорченные
+данные, драйвер не принял программу) возвращается false */
+bool LoadProgramBinary(const std::string& fname, unsigned int& program) {
+  std::ifstream f(fname, std::ios_base::in | std::ios_base::binary);
+  if (!f) {
+    return false;
+  }
+
+  uint32_t header[3];  // Метка, формат, размер
+  if (!f.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+      header[0] != kBinaryCacheMagic || header[2] == 0 ||
+      header[2] > kMaxBinaryCacheSize) {
+    return false;
+  }
+  std::vector<char> data(header[2]);
+  if (!f.read(data.data(), data.size())) {
+    return false;
+  }
+
+  GLuint ps_i = glCreateProgram();
+  glProgramBinary(ps_i, header[1], data.data(), GLsizei(data.size()));
+  GLint success = GL_FALSE;
+  glGetProgramiv(ps_i, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(ps_i);
+    return false;
+  }
+
+  program = ps_i;
+  return true;
+}
+
+
+/*! Сохранить программу в файл кэша. Ошибки сохранения не критичны, программа
+просто будет собираться из исходников при следующем запуске
+\param fname имя файла кэша
+\param program идентификатор слинкованной gl программы */
+void SaveProgramBinary(const std::string& fname, unsigned int program) {
+  GLint len = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+  if (len <= 0 || uint32_t(len) > kMaxBinaryCacheSize) {
+    return;
+  }
+
+  std::vector<char> data(len);
+  GLenum format = 0;
+  GLsizei written = 0;
+  glGetProgramBinary(program, len, &written, &format, data.data());
+  if (written <= 0) {
+    return;
+  }
+
+  std::ofstream f(
+      fname, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+  if (!f) {
+    std::cerr << "WARNING: Can't write shader cache '" << fname << "'"
+              << std::endl;
+    return;
+  }
+  uint32_t header[3] = {kBinaryCacheMagic, format, uint32_t(written)};
+  f.write(reinterpret_cast<const char*>(header), sizeof(header));
+  f.write(data.data(), written);
+}
+
 
 bool CreateShaderProgram(unsigned int& program, unsigned char* vert_data,
     unsigned int vert_len, unsigned char* frag_data, unsigned int frag_len) {
   GLint success;
   std::string vs(vert_data, vert_data + vert_len);
+  std::string fs(frag_data, frag_data + frag_len);
+
+  auto cache_name = GetBinaryCacheName(vs, fs);
+  if (!cache_name.empty() && LoadProgramBinary(cache_name, program)) {
+    return true;
+  }
+
   GLuint vs_i = glCreateShader(GL_VERTEX_SHADER);
   const GLchar* vs_char = vs.data();
   glShaderSource(vs_i, 1, &vs_char, NULL);
@@ -37,7 +166,6 @@ bool CreateShaderProgram(unsigned int& program, unsigned char* vert_data,
     return false;
   }
 
-  std::string fs(frag_data, frag_data + frag_len);
   GLuint fs_i = glCreateShader(GL_FRAGMENT_SHADER);
   const GLchar* fs_char = fs.data();
   glShaderSource(fs_i, 1, &fs_char, NULL);
@@ -52,10 +180,14 @@ bool CreateShaderProgram(unsigned int& program, unsigned char* vert_data,
       glGetShaderInfoLog(fs_i, log_len, NULL, msg.data());
       std::cerr << msg.data() << std::endl << std::endl;
     }
+    glDeleteShader(vs_i);
     return false;
   }
 
   GLuint ps_i = glCreateProgram();
+  if (!cache_name.empty()) {
+    glProgramParameteri(ps_i, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
 
   glAttachShader(ps_i, vs_i);
   glAttachShader(ps_i, fs_i);
@@ -75,8 +207,84 @@ bool CreateShaderProgram(unsigned int& program, unsigned char* vert_data,
   glDeleteShader(fs_i);
   glDeleteShader(vs_i);
 
+  if (!success) {
+    glDeleteProgram(ps_i);
+    return false;
+  }
+
+  if (!cache_name.empty()) {
+    SaveProgramBinary(cache_name, ps_i);
+  }
+
   program = ps_i;
   return true;
 }
 
 void DeleteShaderProgram(unsigned int program) { glDeleteProgram(program); }
+
+
+thread_local unsigned int ShaderProgram::current_program_ = 0;
+
+
+ShaderProgram::ShaderProgram(): program_(0) {}
+
+
+bool ShaderProgram::Create(unsigned char* vert_data, unsigned int vert_len,
+    unsigned char* frag_data, unsigned int frag_len,
+    const std::vector<std::string>& uniforms,
+    const std::vector<std::pair<std::string, unsigned int>>& blocks) {
+  assert(program_ == 0);
+  if (!CreateShaderProgram(
+          program_, vert_data, vert_len, frag_data, frag_len)) {
+    return false;
+  }
+
+  locations_.clear();
+  locations_.reserve(uniforms.size());
+  for (auto& name : uniforms) {
+    locations_.push_back(glGetUniformLocation(program_, name.c_str()));
+  }
+
+  for (auto& block : blocks) {
+    GLuint index = glGetUniformBlockIndex(program_, block.first.c_str());
+    if (index == GL_INVALID_INDEX) {
+      continue;
+    }
+    glUniformBlockBinding(program_, index, block.second);
+  }
+
+  return true;
+}
+
+
+void ShaderProgram::Delete() {
+  if (program_ == 0) {
+    return;
+  }
+  if (current_program_ == program_) {
+    glUseProgram(0);
+    current_program_ = 0;
+  }
+  DeleteShaderProgram(program_);
+  program_ = 0;
+  locations_.clear();
+}
+
+
+void ShaderProgram::Use() {
+  assert(program_ != 0);
+  if (current_program_ == program_) {
+    return;
+  }
+  glUseProgram(program_);
+  current_program_ = program_;
+}
+
+
+int ShaderProgram::Location(size_t index) const {
+  assert(index < locations_.size());
+  if (index >= locations_.size()) {
+    return -1;
+  }
+  return locations_[index];
+}
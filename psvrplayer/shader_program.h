@@ -2,8 +2,13 @@
 #define SHADER_PROGRAM_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
-/*! Создать gl программу на основе вершинного и фрагментного шейдера
+/*! Создать gl программу на основе вершинного и фрагментного шейдера.
+Если драйвер поддерживает бинарные программы, то собранная программа
+сохраняется в кэше в папке данных и при следующем запуске загружается оттуда.
+Испорченный или устаревший кэш игнорируется и программа собирается заново
 \param programm возвращаемый идентификатор созданной gl программы
 \param vert_data текстовый блок с вершинным шейдером
 \param vert_len длина текстового блока с вершинным шейдером
@@ -17,4 +22,51 @@ bool CreateShaderProgram(unsigned int& program, unsigned char* vert_data,
 \param program программа для удаления */
 void DeleteShaderProgram(unsigned int program);
 
+
+/*! Обёртка над gl программой. Положения uniform-переменных запрашиваются один
+раз при создании программы, блоки uniform-переменных привязываются к заданным
+точкам привязки. Также отслеживается текущая программа потока, чтобы не
+выполнять повторные glUseProgram. Как и сама gl программа, объект используется
+только в потоке с текущим контекстом */
+class ShaderProgram {
+ public:
+  ShaderProgram();
+  ~ShaderProgram() = default;
+
+  /*! Создать программу (см. CreateShaderProgram) и получить положения
+  uniform-переменных.
+  \param uniforms имена uniform-переменных. Положение переменной потом
+  запрашивается по индексу имени в этом списке
+  \param blocks пары (имя блока uniform-переменных; точка привязки). Блоки,
+  которых нет в программе, пропускаются
+  \return признак успешного создания программы */
+  bool Create(unsigned char* vert_data, unsigned int vert_len,
+      unsigned char* frag_data, unsigned int frag_len,
+      const std::vector<std::string>& uniforms,
+      const std::vector<std::pair<std::string, unsigned int>>& blocks);
+
+  /*! Удалить программу, освободить ресурсы */
+  void Delete();
+
+  /*! Сделать программу текущей. Если программа уже текущая, то ничего не
+   * делается */
+  void Use();
+
+  /*! Выдать положение uniform-переменной по индексу имени из Create.
+  \return положение переменной или -1, если переменной нет в программе */
+  int Location(size_t index) const;
+
+ private:
+  ShaderProgram(const ShaderProgram&) = delete;
+  ShaderProgram(ShaderProgram&&) = delete;
+  ShaderProgram& operator=(const ShaderProgram&) = delete;
+  ShaderProgram& operator=(ShaderProgram&&) = delete;
+
+  unsigned int program_;  //!< Идентификатор gl программы
+  std::vector<int> locations_;  //!< Положения uniform-переменных
+
+  static thread_local unsigned int
+      current_program_;  //!< Текущая программа в потоке
+};
+
 #endif  // SHADER_PROGRAM_H
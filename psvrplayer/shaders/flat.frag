@@ -5,7 +5,14 @@
 out vec4 color;
 in vec4 scene_pos;
 uniform sampler2D image;
-uniform float width2height;
+// Параметры кадра. Общий блок для всех программ, см. FrameUniforms
+// Матрица хранится по строкам (row_major): вектор умножается на неё слева
+layout (std140, row_major) uniform FrameParameters {
+  mat4 transformation; // Матрица трансформации. Содержит трансляцию, поворот и перспективу
+  float width2height;
+  float image_width; //!< Реальная ширина изобаржения (в долях) относительно полной
+  float eyes_correction;
+};
 
 void main()
 {
@@ -1,7 +1,14 @@
 #version 330 core
 
 layout (location = 0) in vec3 position;
-uniform mat4 transformation; // Матрица трансформации. Содержит трансляцию, поворот и перспективу
+// Параметры кадра. Общий блок для всех программ, см. FrameUniforms
+// Матрица хранится по строкам (row_major): вектор умножается на неё слева
+layout (std140, row_major) uniform FrameParameters {
+  mat4 transformation; // Матрица трансформации. Содержит трансляцию, поворот и перспективу
+  float width2height;
+  float image_width; //!< Реальная ширина изобаржения (в долях) относительно полной
+  float eyes_correction;
+};
 out vec4 scene_pos;
 
 void main()
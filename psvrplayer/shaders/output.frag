@@ -4,10 +4,17 @@ out vec4 color;
 in vec2 screen_pos; // Позиция тикселя на экране x = 0 .. 1 (направо); y = 0 .. 1 (вверх);
 uniform sampler2D left_image;
 uniform sampler2D right_image;
-// Сведение каждого глазного изображения в центр в долях. Т.е. если параметр
-// равен 0.5, то центральная точка изображения будет отображаться на стыке
-// изображений
-uniform float eyes_correction;
+// Параметры кадра. Общий блок для всех программ, см. FrameUniforms
+// Матрица хранится по строкам (row_major): вектор умножается на неё слева
+layout (std140, row_major) uniform FrameParameters {
+  mat4 transformation; // Матрица трансформации. Содержит трансляцию, поворот и перспективу
+  float width2height;
+  float image_width; //!< Реальная ширина изобаржения (в долях) относительно полной
+  // Сведение каждого глазного изображения в центр в долях. Т.е. если параметр
+  // равен 0.5, то центральная точка изображения будет отображаться на стыке
+  // изображений
+  float eyes_correction;
+};
 
 // Включить отладочный код для подбора параметров дистории
 // #define DEBUG_DISTORSION
@@ -3,8 +3,18 @@
 out vec4 color;
 in vec2 scene_pos; //!< Позиция пикселя в сцене. Диапазон x=-1..+1; y=-1..+1
 uniform sampler2D image;
-uniform int part_index;
-uniform float image_width; //!< Реальная ширина изобаржения (в долях) относительно полной
+// Параметры кадра. Общий блок для всех программ, см. FrameUniforms
+// Матрица хранится по строкам (row_major): вектор умножается на неё слева
+layout (std140, row_major) uniform FrameParameters {
+  mat4 transformation; // Матрица трансформации. Содержит трансляцию, поворот и перспективу
+  float width2height;
+  float image_width; //!< Реальная ширина изобаржения (в долях) относительно полной
+  float eyes_correction;
+};
+// Параметры глаза, см. EyeUniforms
+layout (std140) uniform EyeParameters {
+  int part_index;
+};
 
 void main()
 {
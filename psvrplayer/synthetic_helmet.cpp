@@ -0,0 +1,243 @@
+#include "synthetic_helmet.h"
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/quaternion.hpp>
+
+#include "metrics.h"
+#include "thread_policy.h"
+
+const double kPi = 3.1415926535897932384626433832795;
+
+
+SyntheticHelmet::SyntheticHelmet(const std::string& script)
+    : random_(kJitterSeed),
+      yaw_(0.0),
+      pitch_(0.0),
+      center_(1.0, 0.0, 0.0, 0.0) {
+  shutdown_flag_ = false;
+  center_view_flag_ = false;
+
+  if (!ParseScript(script)) {
+    std::cerr << "Wrong synthetic helmet script '" << script << "'"
+              << std::endl;
+    throw std::runtime_error("Wrong synthetic helmet script");
+  }
+
+  std::thread t([this]() { Steps(); });
+  std::swap(step_thread_, t);
+  assert(!t.joinable());
+}
+
+
+SyntheticHelmet::~SyntheticHelmet() {
+  shutdown_flag_ = true;
+  if (step_thread_.joinable()) {
+    step_thread_.join();
+  }
+}
+
+
+void SyntheticHelmet::SetVRMode(VRMode) {}
+
+
+void SyntheticHelmet::CenterView() { center_view_flag_ = true; }
+
+
+void SyntheticHelmet::GetViewPoint(glm::mat4& rot_mat) {
+  rotation_.GetSummRotation(rot_mat);
+}
+
+
+void SyntheticHelmet::GetViewPointAt(
+    std::chrono::steady_clock::time_point time, glm::mat4& rot_mat) {
+  int64_t mcs = std::chrono::duration_cast<std::chrono::microseconds>(
+      time.time_since_epoch())
+                    .count();
+  glm::dquat pose;
+  if (history_.GetPoseAt(mcs, pose)) {
+    rotation_.GetRotation(pose, rot_mat);
+  } else {
+    rotation_.GetSummRotation(rot_mat);
+  }
+}
+
+
+void SyntheticHelmet::SetRotationSpeedup(double speedup) {
+  rotation_.SetRotationSpeedup(speedup);
+}
+
+
+void SyntheticHelmet::SetWornFn(std::function<void(bool worn)> fn) {
+  // Искусственный шлем всегда надет
+  if (fn) {
+    fn(true);
+  }
+}
+
+
+bool SyntheticHelmet::ParseScript(const std::string& script) {
+  script_.clear();
+  std::stringstream ss(script);
+  std::string item;
+  while (std::getline(ss, item, ';')) {
+    if (item.empty()) {
+      continue;
+    }
+    std::vector<std::string> parts;
+    std::stringstream is(item);
+    std::string part;
+    while (std::getline(is, part, ':')) {
+      parts.push_back(part);
+    }
+
+    Segment seg;
+    seg.amplitude = 0.0;
+    seg.period = 1.0;
+    size_t args = 0;
+    if (parts[0] == "hold") {
+      seg.type = Segment::kHold;
+      args = 1;
+    } else if (parts[0] == "sweep" || parts[0] == "nod") {
+      seg.type = parts[0] == "sweep" ? Segment::kSweep : Segment::kNod;
+      args = 3;
+    } else if (parts[0] == "snap") {
+      seg.type = Segment::kSnap;
+      args = 2;
+    } else if (parts[0] == "jitter") {
+      seg.type = Segment::kJitter;
+      args = 2;
+    } else {
+      return false;
+    }
+    if (parts.size() != args + 1) {
+      return false;
+    }
+
+    double duration;
+    try {
+      if (args > 1) {
+        seg.amplitude = std::stod(parts[1]);
+      }
+      if (args > 2) {
+        seg.period = std::stod(parts[2]);
+      }
+      duration = std::stod(parts.back());
+    } catch (...) {
+      return false;
+    }
+    seg.steps = std::llround(duration * 1000000.0 / kStepInterval);
+    if (seg.steps <= 0 || seg.period <= 0.0) {
+      return false;
+    }
+    script_.push_back(seg);
+  }
+  return !script_.empty();
+}
+
+
+void SyntheticHelmet::SegmentPose(
+    const Segment& segment, int64_t step, double& yaw, double& pitch) {
+  yaw = yaw_;
+  pitch = pitch_;
+  double t = double(step * kStepInterval) * 0.000001;
+  switch (segment.type) {
+    case Segment::kHold:
+      break;
+    case Segment::kSweep:
+      yaw += segment.amplitude * std::sin(2.0 * kPi * t / segment.period);
+      break;
+    case Segment::kNod:
+      pitch += segment.amplitude * std::sin(2.0 * kPi * t / segment.period);
+      break;
+    case Segment::kSnap: {
+      // Плавный разгон и торможение (smoothstep)
+      double x = double(step + 1) / double(segment.steps);
+      yaw += segment.amplitude * x * x * (3.0 - 2.0 * x);
+    } break;
+    case Segment::kJitter: {
+      std::uniform_real_distribution<double> d(
+          -segment.amplitude, segment.amplitude);
+      yaw += d(random_);
+      pitch += d(random_);
+    } break;
+  }
+}
+
+
+void SyntheticHelmet::Steps() {
+  const glm::dvec3 kTipAxis(0.0, 1.0, 0.0);
+  const glm::dvec3 kRightAxis(1.0, 0.0, 0.0);
+  auto start = std::chrono::steady_clock::now();
+  int64_t start_mcs = std::chrono::duration_cast<std::chrono::microseconds>(
+      start.time_since_epoch())
+                          .count();
+  int64_t counter = 0;
+  glm::dquat prev;
+  size_t index = 0;
+  int64_t step = 0;
+  auto& step_latency = Metrics::GetHistogram("synthetic_wakeup_us");
+  SetupThread("synthetic");
+
+  while (!shutdown_flag_) {
+    const Segment& seg = script_[index];
+    double yaw, pitch;
+    SegmentPose(seg, step, yaw, pitch);
+
+    if (center_view_flag_.exchange(false)) {
+      center_ = glm::conjugate(glm::angleAxis(glm::radians(yaw), kTipAxis) *
+                               glm::angleAxis(glm::radians(-pitch), kRightAxis));
+      history_.Clear();
+    }
+    auto pose = glm::normalize(
+        center_ * glm::angleAxis(glm::radians(yaw), kTipAxis) *
+        glm::angleAxis(glm::radians(-pitch), kRightAxis));
+    rotation_.SetOrientation(pose);
+
+    // Угловая скорость по разности с предыдущим шагом
+    PoseHistory::Pose hp;
+    hp.time = start_mcs + counter * kStepInterval;
+    hp.orientation = pose;
+    hp.velocity = glm::dvec3(0.0, 0.0, 0.0);
+    if (counter > 0) {
+      auto delta = pose * glm::conjugate(prev);
+      if (delta.w < 0.0) {
+        delta = -delta;
+      }
+      glm::dvec3 axis(delta.x, delta.y, delta.z);
+      double sin_half = glm::length(axis);
+      if (sin_half > 0.0) {
+        double angle = 2.0 * std::atan2(sin_half, delta.w);
+        hp.velocity =
+            axis * (angle / sin_half / (kStepInterval * 0.000001));
+      }
+    }
+    history_.Add(hp);
+    prev = pose;
+
+    // Следующий шаг сценария. В конце участка запоминаем достигнутое
+    // положение как базовое для следующего, чтобы качание с нецелым числом
+    // периодов не давало скачка. Дрожание положение не смещает
+    ++step;
+    if (step >= seg.steps) {
+      if (seg.type != Segment::kJitter) {
+        yaw_ = yaw;
+        pitch_ = pitch;
+      }
+      step = 0;
+      index = (index + 1) % script_.size();
+    }
+
+    ++counter;
+    auto wakeup = start + std::chrono::microseconds(counter * kStepInterval);
+    std::this_thread::sleep_until(wakeup);
+    step_latency.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - wakeup)
+                         .count());
+  }
+}
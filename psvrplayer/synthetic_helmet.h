@@ -0,0 +1,90 @@
+#ifndef SYNTHETIC_HELMET_H
+#define SYNTHETIC_HELMET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pose_history.h"
+#include "rotation.h"
+#include "vr_helmet.h"
+
+/*! Искусственный шлем без устройства. Движение головы задаётся сценарием и
+рассчитывается с частотой 1 кГц строго по номеру шага, поэтому при одинаковом
+сценарии положения всегда одни и те же.
+Сценарий - список участков через ';', проигрываемый по кругу:
+  hold:<сек> - неподвижно
+  sweep:<градусы>:<период, сек>:<сек> - качание по горизонтали (синус)
+  nod:<градусы>:<период, сек>:<сек> - качание по вертикали (синус)
+  snap:<градусы>:<сек> - быстрый поворот по горизонтали на заданный угол
+  jitter:<градусы>:<сек> - дрожание с заданной амплитудой
+Каждый участок начинается с положения, достигнутого в конце предыдущего
+(после дрожания - с положения до него).
+Например: "sweep:30:4:8;snap:45:0.1;hold:1;jitter:0.3:2" */
+class SyntheticHelmet: public IHelmet {
+ public:
+  /*! Создать шлем по сценарию. Если сценарий неправильный, то выбрасывается
+  исключение */
+  explicit SyntheticHelmet(const std::string& script);
+  virtual ~SyntheticHelmet();
+
+  void SetVRMode(VRMode mode) override;
+  void CenterView() override;
+  void GetViewPoint(glm::mat4& rotation) override;
+  void GetViewPointAt(std::chrono::steady_clock::time_point time,
+      glm::mat4& rotation) override;
+  void SetRotationSpeedup(double speedup) override;
+  void SetWornFn(std::function<void(bool worn)> fn) override;
+
+ private:
+  SyntheticHelmet(const SyntheticHelmet&) = delete;
+  SyntheticHelmet(SyntheticHelmet&&) = delete;
+  SyntheticHelmet& operator=(const SyntheticHelmet&) = delete;
+  SyntheticHelmet& operator=(SyntheticHelmet&&) = delete;
+
+  const int64_t kStepInterval = 1000;  //!< Интервал шага, мкс
+  const unsigned int kJitterSeed = 1;  //!< Начальное значение для дрожания
+
+  /*! Участок сценария */
+  struct Segment {
+    enum Type { kHold, kSweep, kNod, kSnap, kJitter } type;
+    double amplitude;  //!< Амплитуда или угол, градусы
+    double period;  //!< Период качания, сек
+    int64_t steps;  //!< Длительность в шагах
+  };
+
+  std::vector<Segment> script_;  //!< Разобранный сценарий
+  std::thread step_thread_;  //!< Поток расчёта положений
+  std::atomic_bool shutdown_flag_;  //!< Флаг завершения потока
+  std::atomic_bool center_view_flag_;  //!< Запрос на центрирование
+
+  // Используются только потоком расчёта положений
+  std::mt19937 random_;  //!< Генератор дрожания
+  double yaw_;  //!< Поворот по горизонтали в начале участка, градусы
+  double pitch_;  //!< Поворот по вертикали в начале участка, градусы
+  glm::dquat center_;  //!< Поворот центрирования
+
+  Rotation rotation_;  //!< Текущее положение
+  PoseHistory history_;  //!< История положений для запросов на время
+
+  /*! Разобрать сценарий
+  \return признак успешного разбора */
+  bool ParseScript(const std::string& script);
+
+  /*! Функция расчёта положений. Выполняется в отдельном потоке */
+  void Steps();
+
+  /*! Рассчитать положение на шаге участка
+  \param segment участок сценария
+  \param step номер шага внутри участка
+  \param yaw возвращаемый поворот по горизонтали, градусы
+  \param pitch возвращаемый поворот по вертикали, градусы */
+  void SegmentPose(
+      const Segment& segment, int64_t step, double& yaw, double& pitch);
+};
+
+#endif  // SYNTHETIC_HELMET_H
@@ -0,0 +1,331 @@
+#include "synthetic_video_player.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "metrics.h"
+#include "thread_policy.h"
+#include "trace.h"
+
+namespace {
+
+const int kDarkLevel = 16;  //!< Яркость каналов, ниже которой фона нет
+
+
+/*! Выдать яркость канала фона для двух бит номера кадра. Все уровни
+ненулевые, поэтому фон отличается от чёрного */
+uint8_t TagLevel(int64_t bits) { return uint8_t(32 + 64 * (bits & 3)); }
+
+}  // namespace
+
+
+SyntheticVideoPlayer::SyntheticVideoPlayer()
+    : movie_state_(IVideoPlayer::MovieState::kNoMovie),
+      position_(0),
+      paused_(false),
+      playing_(false),
+      shutdown_flag_(false) {
+  movie_ = Movie{0, 0, 0.0, Layout::kMono, 0};
+}
+
+
+SyntheticVideoPlayer::~SyntheticVideoPlayer() {
+  std::lock_guard<std::mutex> cl(control_lock_);
+  StopGenerating();
+}
+
+
+bool SyntheticVideoPlayer::OpenMovie(const std::string& filename) {
+  std::lock_guard<std::mutex> lk(state_lock_);
+  if (movie_state_ != IVideoPlayer::MovieState::kNoMovie) {
+    std::cerr << "ERROR: Other movie file is opened yet" << std::endl;
+    return false;
+  }
+
+  Movie movie;
+  if (!ParseMovie(filename, movie)) {
+    std::cerr << "Wrong synthetic movie '" << filename << "'" << std::endl;
+    return false;
+  }
+  movie_ = movie;
+  position_ = 0;
+  paused_ = false;
+  movie_state_ = IVideoPlayer::MovieState::kMovieReadyToPlay;
+  return true;
+}
+
+
+void SyntheticVideoPlayer::CloseMovie() {
+  std::lock_guard<std::mutex> cl(control_lock_);
+  StopGenerating();
+  std::lock_guard<std::mutex> lk(state_lock_);
+  movie_state_ = IVideoPlayer::MovieState::kNoMovie;
+}
+
+
+IVideoPlayer::MovieState SyntheticVideoPlayer::GetMovieState() {
+  return movie_state_;
+}
+
+
+IVideoPlayer::MovieState SyntheticVideoPlayer::WaitMovieParsed() {
+  // Описание разбирается сразу при открытии
+  return movie_state_;
+}
+
+
+double SyntheticVideoPlayer::GetFrameRate() {
+  std::lock_guard<std::mutex> lk(state_lock_);
+  if (movie_state_ != IVideoPlayer::MovieState::kMovieReadyToPlay) {
+    return 0.0;
+  }
+  return movie_.frame_rate;
+}
+
+
+bool SyntheticVideoPlayer::Play() {
+  std::lock_guard<std::mutex> cl(control_lock_);
+  std::unique_lock<std::mutex> lk(state_lock_);
+  if (movie_state_ != IVideoPlayer::MovieState::kMovieReadyToPlay) {
+    std::cerr << "Movie isn't opened" << std::endl;
+    return false;
+  }
+  if (playing_) {
+    return true;
+  }
+  // Поток мог завершиться в конце фильма. Тогда фильм начинается сначала
+  if (movie_.frames > 0 && position_ >= movie_.frames) {
+    position_ = 0;
+  }
+  playing_ = true;
+  shutdown_flag_ = false;
+  lk.unlock();
+
+  if (generate_thread_.joinable()) {
+    generate_thread_.join();
+  }
+  std::thread t([this]() { Generate(); });
+  std::swap(generate_thread_, t);
+  assert(!t.joinable());
+  return true;
+}
+
+
+void SyntheticVideoPlayer::Pause(bool pause) {
+  std::unique_lock<std::mutex> lk(state_lock_);
+  paused_ = pause;
+  lk.unlock();
+  state_var_.notify_all();
+}
+
+
+void SyntheticVideoPlayer::Move(int movement) {
+  std::lock_guard<std::mutex> lk(state_lock_);
+  if (movie_state_ != IVideoPlayer::MovieState::kMovieReadyToPlay) {
+    return;
+  }
+  auto newpos =
+      position_ + std::llround(double(movement) * movie_.frame_rate);
+  newpos = std::max<int64_t>(newpos, 0);
+  if (movie_.frames > 0) {
+    newpos = std::min<int64_t>(newpos, movie_.frames - 1);
+  }
+  position_ = newpos;
+}
+
+
+void SyntheticVideoPlayer::SetDisplayFn(std::function<void(Frame&&)> fn) {
+  std::lock_guard<std::mutex> lk(on_display_lock_);
+  on_display_ = fn;
+}
+
+
+int SyntheticVideoPlayer::DecodeColorTag(
+    uint8_t red, uint8_t green, uint8_t blue) {
+  if (red < kDarkLevel && green < kDarkLevel && blue < kDarkLevel) {
+    return -1;
+  }
+  auto bits = [](uint8_t v) { return std::min(3, int(v) / 64); };
+  return (bits(red) << 4) | (bits(green) << 2) | bits(blue);
+}
+
+
+int SyntheticVideoPlayer::ReadColorTag(Frame& frame) {
+  int width, height, align_width;
+  frame.GetSizes(&width, &height, &align_width, nullptr);
+  if (width <= 0 || height <= 0) {
+    return -1;
+  }
+  // Четверть ширины и высоты попадает в фон первой части при любой раскладке
+  size_t data_size;
+  auto data = static_cast<const uint8_t*>(frame.GetData(data_size));
+  size_t offset = (size_t(height / 4) * align_width + width / 4) * 4;
+  if (offset + 4 > data_size) {
+    return -1;
+  }
+  // Пиксель хранится как BGRA
+  return DecodeColorTag(data[offset + 2], data[offset + 1], data[offset]);
+}
+
+
+bool SyntheticVideoPlayer::ParseMovie(
+    const std::string& description, Movie& movie) {
+  std::vector<std::string> parts;
+  std::stringstream ss(description);
+  std::string part;
+  while (std::getline(ss, part, ':')) {
+    parts.push_back(part);
+  }
+  if (parts.size() != 3 && parts.size() != 4) {
+    return false;
+  }
+
+  auto x = parts[0].find('x');
+  if (x == std::string::npos) {
+    return false;
+  }
+  double duration = 0.0;
+  try {
+    movie.width = std::stoi(parts[0].substr(0, x));
+    movie.height = std::stoi(parts[0].substr(x + 1));
+    movie.frame_rate = std::stod(parts[1]);
+    if (parts.size() == 4) {
+      duration = std::stod(parts[3]);
+    }
+  } catch (...) {
+    return false;
+  }
+
+  if (parts[2] == "sbs") {
+    movie.layout = Layout::kSbs;
+  } else if (parts[2] == "ou") {
+    movie.layout = Layout::kOu;
+  } else if (parts[2] == "mono") {
+    movie.layout = Layout::kMono;
+  } else {
+    return false;
+  }
+
+  movie.frames = std::llround(duration * movie.frame_rate);
+  return movie.width >= 16 && movie.height >= 16 && movie.frame_rate > 0.0 &&
+         duration >= 0.0;
+}
+
+
+void SyntheticVideoPlayer::StopGenerating() {
+  std::unique_lock<std::mutex> lk(state_lock_);
+  shutdown_flag_ = true;
+  lk.unlock();
+  state_var_.notify_all();
+  if (generate_thread_.joinable()) {
+    generate_thread_.join();
+  }
+}
+
+
+void SyntheticVideoPlayer::Generate() {
+  SetupThread("video");
+  static auto& decoded = Metrics::GetCounter("frames_decoded");
+  using Clock = std::chrono::steady_clock;
+
+  std::unique_lock<std::mutex> lk(state_lock_);
+  Movie movie = movie_;
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / movie.frame_rate));
+  // Строки выравниваются так же, как в проигрывателе vlc
+  const int align_width = (movie.width + 7) / 8 * 8;
+  const int align_height = (movie.height + 31) / 32 * 32;
+  auto next_frame = Clock::now();
+  while (!shutdown_flag_) {
+    if (paused_) {
+      state_var_.wait(lk, [this] { return shutdown_flag_ || !paused_; });
+      // После паузы расписание начинается заново, без пачки кадров
+      next_frame = Clock::now();
+      continue;
+    }
+    if (state_var_.wait_until(
+            lk, next_frame, [this] { return shutdown_flag_ || paused_; })) {
+      continue;
+    }
+    if (movie.frames > 0 && position_ >= movie.frames) {
+      break;
+    }
+    int64_t number = position_++;
+    lk.unlock();
+
+    {
+      TRACE_SCOPE("SyntheticFrame");
+      Frame frame = RequestFrame(align_width, align_height);
+      frame.SetSize(movie.width, movie.height);
+      DrawFrame(movie, number, frame);
+      decoded.Add();
+
+      std::lock_guard<std::mutex> dl(on_display_lock_);
+      if (on_display_) {
+        on_display_(std::move(frame));
+      } else {
+        ReleaseFrame(std::move(frame));
+      }
+    }
+
+    // Отставание от расписания не догоняется пачкой кадров
+    next_frame += interval;
+    auto now = Clock::now();
+    if (now - next_frame > interval) {
+      next_frame = now;
+    }
+    lk.lock();
+  }
+  playing_ = false;
+}
+
+
+void SyntheticVideoPlayer::DrawFrame(
+    const Movie& movie, int64_t number, Frame& frame) {
+  switch (movie.layout) {
+    case Layout::kSbs: {
+      int half = movie.width / 2;
+      DrawPart(0, 0, half, movie.height, movie, number, frame);
+      DrawPart(half, 0, movie.width - half, movie.height, movie, number, frame);
+    } break;
+    case Layout::kOu: {
+      int half = movie.height / 2;
+      DrawPart(0, 0, movie.width, half, movie, number, frame);
+      DrawPart(0, half, movie.width, movie.height - half, movie, number, frame);
+    } break;
+    case Layout::kMono:
+      DrawPart(0, 0, movie.width, movie.height, movie, number, frame);
+      break;
+  }
+}
+
+
+void SyntheticVideoPlayer::DrawPart(int left, int top, int width, int height,
+    const Movie& movie, int64_t number, Frame& frame) {
+  // Фон с номером кадра
+  frame.DrawRectangle(left, top, width, height, TagLevel(number >> 4),
+      TagLevel(number >> 2), TagLevel(number), 255);
+
+  // Движущаяся полоса между 5/8 и 7/8 высоты
+  int bar_width = std::max(2, width / 64);
+  int64_t sweep_frames =
+      std::max<int64_t>(1, std::llround(kSweepPeriod * movie.frame_rate));
+  int bar_pos =
+      int((number % sweep_frames) * (width - bar_width) / sweep_frames);
+  frame.DrawRectangle(left + bar_pos, top + height * 5 / 8, bar_width,
+      height / 4, 255, 255, 255, 255);
+
+  // Номер кадра двоичными блоками, старший бит слева
+  int block_width = std::max(1, width / kNumberBits);
+  int block_height = std::max(1, height / 32);
+  for (int i = 0; i < kNumberBits; ++i) {
+    uint8_t level = ((number >> (kNumberBits - 1 - i)) & 1) ? 255 : 0;
+    frame.DrawRectangle(left + i * block_width, top + height - block_height,
+        block_width, block_height, level, level, level, 255);
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef SYNTHETIC_VIDEO_PLAYER_H
+#define SYNTHETIC_VIDEO_PLAYER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "framepool.h"
+#include "video_player.h"
+
+/*! Искусственный проигрыватель без файлов и библиотеки vlc: кадры рисуются в
+кадрах пула с заданными размером, частотой и раскладкой. Вместо имени файла
+OpenMovie получает описание фильма:
+  <ширина>x<высота>:<кадров в секунду>:<sbs|ou|mono>[:<длительность, сек>]
+Например: "3840x1080:60:sbs:120". Без длительности фильм бесконечный.
+В каждой части кадра (для каждого глаза):
+  - фон залит цветом номера кадра по модулю kColorTags (по 2 бита на канал),
+  - в нижней половине движется вертикальная полоса,
+  - у нижнего края номер кадра записан двоичными блоками (белый - 1).
+Номер кадра - его позиция в фильме, поэтому перемотка видна по скачку номера,
+а на паузе кадры не выдаются */
+class SyntheticVideoPlayer: public IVideoPlayer {
+ public:
+  SyntheticVideoPlayer();
+  virtual ~SyntheticVideoPlayer();
+
+  bool OpenMovie(const std::string& filename) override;
+  void CloseMovie() override;
+  IVideoPlayer::MovieState GetMovieState() override;
+  IVideoPlayer::MovieState WaitMovieParsed() override;
+  double GetFrameRate() override;
+  bool Play() override;
+  void Pause(bool pause) override;
+  void Move(int movement) override;
+  void SetDisplayFn(std::function<void(Frame&&)> fn) override;
+
+  static const int kColorTags = 64;  //!< Количество номеров в цвете фона
+
+  /*! Разобрать номер кадра по цвету фона
+  \return номер кадра по модулю kColorTags или -1, если цвет тёмный (не фон
+  кадра) */
+  static int DecodeColorTag(uint8_t red, uint8_t green, uint8_t blue);
+
+  /*! Считать номер кадра по модулю kColorTags из фона кадра
+  \return номер кадра или -1, если в кадре нет фона с номером */
+  static int ReadColorTag(Frame& frame);
+
+ private:
+  SyntheticVideoPlayer(const SyntheticVideoPlayer&) = delete;
+  SyntheticVideoPlayer(SyntheticVideoPlayer&&) = delete;
+  SyntheticVideoPlayer& operator=(const SyntheticVideoPlayer&) = delete;
+  SyntheticVideoPlayer& operator=(SyntheticVideoPlayer&&) = delete;
+
+  static const int kNumberBits = 32;  //!< Двоичных блоков номера кадра
+  const double kSweepPeriod = 4.0;  //!< Время прохода полосы по кадру, сек
+
+  /*! Раскладка частей кадра для глаз */
+  enum class Layout { kSbs, kOu, kMono };
+
+  /*! Описание фильма */
+  struct Movie {
+    int width;  //!< Ширина кадра в пикселях
+    int height;  //!< Высота кадра в пикселях
+    double frame_rate;  //!< Частота кадров
+    Layout layout;  //!< Раскладка частей кадра
+    int64_t frames;  //!< Количество кадров. 0 - фильм бесконечный
+  };
+
+  std::atomic<IVideoPlayer::MovieState> movie_state_;
+  std::mutex state_lock_;  //!< Блокировка состояния воспроизведения
+  std::condition_variable state_var_;  //!< Событие смены состояния
+  Movie movie_;  //!< Открытый фильм. Под блокировкой state_lock_
+  int64_t position_;  //!< Номер следующего кадра. Под блокировкой state_lock_
+  bool paused_;  //!< Признак паузы. Под блокировкой state_lock_
+  bool playing_;  //!< Признак работы потока выдачи кадров. Под блокировкой
+                  //!< state_lock_
+  bool shutdown_flag_;  //!< Флаг завершения потока. Под блокировкой
+                        //!< state_lock_
+  std::thread generate_thread_;  //!< Поток выдачи кадров
+  std::mutex control_lock_;  //!< Блокировка запуска и остановки потока
+
+  std::function<void(Frame&&)> on_display_;
+  std::mutex on_display_lock_;
+
+  /*! Разобрать описание фильма
+  \return признак успешного разбора */
+  static bool ParseMovie(const std::string& description, Movie& movie);
+
+  /*! Остановить поток выдачи кадров. Вызывается под блокировкой
+  control_lock_, но без блокировки state_lock_ */
+  void StopGenerating();
+
+  /*! Функция выдачи кадров по расписанию. Выполняется в отдельном потоке */
+  void Generate();
+
+  /*! Нарисовать кадр
+  \param movie описание фильма
+  \param number номер кадра
+  \param frame кадр с размером фильма */
+  void DrawFrame(const Movie& movie, int64_t number, Frame& frame);
+
+  /*! Нарисовать часть кадра для одного глаза
+  \param left, top, width, height положение и размеры части
+  \param movie описание фильма
+  \param number номер кадра
+  \param frame кадр для рисования */
+  void DrawPart(int left, int top, int width, int height, const Movie& movie,
+      int64_t number, Frame& frame);
+};
+
+#endif  // SYNTHETIC_VIDEO_PLAYER_H
@@ -0,0 +1,114 @@
+#ifdef __linux__
+#define POSIX_THREAD_POLICY
+#endif
+
+#include "thread_policy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef POSIX_THREAD_POLICY
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "config_file.h"
+#include "trace.h"
+
+const char kThreadNamePrefix[] = "psvr-";
+const size_t kMaxThreadName = 15;  //!< Ограничение длины имени потока Linux
+
+
+#ifdef POSIX_THREAD_POLICY
+/*! Разобрать список процессоров вида "0,2-3"
+\return признак корректного списка */
+static bool ParseCpus(const std::string& cpus, cpu_set_t& set) {
+  CPU_ZERO(&set);
+  std::istringstream in(cpus);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream range(item);
+    if (!(range >> first)) {
+      return false;
+    }
+    last = first;
+    if (range >> dash) {
+      if (dash != '-' || !(range >> last)) {
+        return false;
+      }
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return CPU_COUNT(&set) > 0;
+}
+#endif
+
+
+void SetupThread(const std::string& role) {
+  std::string cpus;
+  int fifo = 0;
+  int nice = 0;
+  Config::GetThreadOptions(role, &cpus, &fifo, &nice);
+
+  auto name = kThreadNamePrefix + role;
+  TRACE_THREAD_NAME(name);
+
+#ifdef POSIX_THREAD_POLICY
+  pthread_setname_np(pthread_self(), name.substr(0, kMaxThreadName).c_str());
+
+  if (!cpus.empty()) {
+    cpu_set_t set;
+    if (!ParseCpus(cpus, set)) {
+      std::cerr << "Wrong CPU list '" << cpus << "' for thread '" << role
+                << "'" << std::endl;
+    } else {
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      if (err != 0) {
+        std::cerr << "Can't set CPU affinity for thread '" << role
+                  << "': " << std::strerror(err) << std::endl;
+      }
+    }
+  }
+
+  bool realtime = false;
+  if (fifo > 0) {
+    sched_param sp;
+    sp.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+        std::min(fifo, sched_get_priority_max(SCHED_FIFO)));
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (err == 0) {
+      realtime = true;
+    } else {
+      std::cerr << "Can't set real-time priority for thread '" << role
+                << "': " << std::strerror(err) << ". Nice value is used"
+                << std::endl;
+    }
+  }
+
+  // В Linux nice задаётся отдельно для каждого потока
+  if (!realtime && nice != 0) {
+    auto tid = id_t(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, nice) != 0) {
+      std::cerr << "Can't set nice value for thread '" << role
+                << "': " << std::strerror(errno) << std::endl;
+    }
+  }
+#else
+  if (!cpus.empty() || fifo > 0 || nice != 0) {
+    std::cerr << "Thread policy is not supported on this system" << std::endl;
+  }
+#endif
+}
@@ -0,0 +1,14 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include <string>
+
+/*! Настроить текущий поток по его роли: дать потоку имя "psvr-<роль>" и
+применить из конфигурации привязку к процессорам и приоритет (секция
+[Threads], ключи <роль>_cpus, <роль>_fifo, <роль>_nice). Если приоритет
+реального времени недоступен без привилегий, используется nice. Ошибки
+настройки не мешают работе потока и только выводятся в std::cerr
+\param role роль потока: sensors, render, video, synthetic, harness, worn */
+void SetupThread(const std::string& role);
+
+#endif  // THREAD_POLICY_H
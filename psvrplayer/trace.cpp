@@ -0,0 +1,238 @@
+#include "trace.h"
+
+#include <iostream>
+
+#ifdef PSVR_TRACING
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+
+#ifdef PSVR_TRACING
+namespace {
+
+const size_t kChunkEvents = 65536;  //!< Событий в одном блоке буфера потока
+const size_t kMaxChunks = 64;  //!< Наибольшее количество блоков у потока
+
+/*! Событие трассировки */
+struct Event {
+  const char* name;  //!< Имя события
+  int64_t start;  //!< Время события, нс
+  int64_t duration;  //!< Длительность, нс
+  double value;  //!< Значение счётчика
+  char type;  //!< Тип события в формате Chrome trace: X, C или i
+};
+
+/*! Буфер событий потока. Пишет только свой поток, читает - Stop после
+публикации количества событий */
+struct ThreadBuffer {
+  uint64_t id;  //!< Номер потока в трассировке
+  std::string name;  //!< Имя потока. Под блокировкой g_TraceLock
+  std::unique_ptr<Event[]> chunks[kMaxChunks];  //!< Блоки событий
+  std::atomic<size_t> count;  //!< Количество записанных событий
+  std::atomic<uint64_t> dropped;  //!< Количество не поместившихся событий
+};
+
+std::mutex g_TraceLock;  //!< Блокировка списка буферов и файла
+std::vector<std::unique_ptr<ThreadBuffer>>
+    g_TraceBuffers;  //!< Буферы всех потоков. Живут до конца работы
+std::string g_TraceFileName;  //!< Файл для сохранения трассировки
+std::chrono::steady_clock::time_point g_TraceStart;  //!< Начало трассировки
+thread_local ThreadBuffer* t_TraceBuffer = nullptr;  //!< Буфер потока
+
+
+/*! Выдать буфер текущего потока, создав его при первом обращении */
+ThreadBuffer* CurrentBuffer() {
+  if (!t_TraceBuffer) {
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+    buffer->count = 0;
+    buffer->dropped = 0;
+    std::lock_guard<std::mutex> lk(g_TraceLock);
+    buffer->id = g_TraceBuffers.size() + 1;
+    buffer->name = "thread-" + std::to_string(buffer->id);
+    t_TraceBuffer = buffer.get();
+    g_TraceBuffers.push_back(std::move(buffer));
+  }
+  return t_TraceBuffer;
+}
+
+
+/*! Добавить событие в буфер текущего потока */
+void Append(const Event& event) {
+  ThreadBuffer* buffer = CurrentBuffer();
+  size_t count = buffer->count.load(std::memory_order_relaxed);
+  size_t chunk = count / kChunkEvents;
+  if (chunk >= kMaxChunks) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (!buffer->chunks[chunk]) {
+    buffer->chunks[chunk].reset(new Event[kChunkEvents]);
+  }
+  buffer->chunks[chunk][count % kChunkEvents] = event;
+  // Публикуем событие (и новый блок) для чтения в Stop
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+
+/*! Записать строку в формате JSON */
+void WriteString(std::ostream& out, const std::string& text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+
+/*! Записать время в микросекундах с дробной частью */
+void WriteTime(std::ostream& out, int64_t ns) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", ns / 1000.0);
+  out << buffer;
+}
+
+}  // namespace
+
+
+std::atomic_bool Trace::enabled_flag(false);
+
+
+int64_t Trace::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - g_TraceStart)
+      .count();
+}
+
+
+void Trace::SetThreadName(const std::string& name) {
+  ThreadBuffer* buffer = CurrentBuffer();
+  std::lock_guard<std::mutex> lk(g_TraceLock);
+  buffer->name = name;
+}
+
+
+void Trace::Complete(const char* name, int64_t start, int64_t end) {
+  Event event;
+  event.name = name;
+  event.start = start;
+  event.duration = end - start;
+  event.value = 0.0;
+  event.type = 'X';
+  Append(event);
+}
+
+
+void Trace::Counter(const char* name, double value) {
+  Event event;
+  event.name = name;
+  event.start = Now();
+  event.duration = 0;
+  event.value = value;
+  event.type = 'C';
+  Append(event);
+}
+
+
+void Trace::Instant(const char* name) {
+  Event event;
+  event.name = name;
+  event.start = Now();
+  event.duration = 0;
+  event.value = 0.0;
+  event.type = 'i';
+  Append(event);
+}
+
+
+bool Trace::Start(const std::string& fname) {
+  std::unique_lock<std::mutex> lk(g_TraceLock);
+  g_TraceFileName = fname;
+  g_TraceStart = std::chrono::steady_clock::now();
+  lk.unlock();
+
+  SetThreadName("psvr-main");
+  enabled_flag.store(true, std::memory_order_release);
+  return true;
+}
+
+
+void Trace::Stop() {
+  if (!enabled_flag.exchange(false)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(g_TraceLock);
+  std::ofstream out(g_TraceFileName, std::ios_base::out | std::ios_base::trunc);
+  if (!out) {
+    std::cerr << "Can't create trace file '" << g_TraceFileName << "'"
+              << std::endl;
+    return;
+  }
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  uint64_t dropped = 0;
+  for (const auto& buffer : g_TraceBuffers) {
+    if (!first) {
+      out << ",";
+    }
+    first = false;
+    out << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+        << buffer->id << ",\"args\":{\"name\":";
+    WriteString(out, buffer->name);
+    out << "}}";
+
+    size_t count = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+      const Event& event = buffer->chunks[i / kChunkEvents][i % kChunkEvents];
+      out << ",\n{\"ph\":\"" << event.type << "\",\"name\":";
+      WriteString(out, event.name);
+      out << ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+      WriteTime(out, event.start);
+      switch (event.type) {
+        case 'X':
+          out << ",\"dur\":";
+          WriteTime(out, event.duration);
+          break;
+        case 'C':
+          out << ",\"args\":{\"value\":" << event.value << "}";
+          break;
+        default:
+          out << ",\"s\":\"t\"";
+          break;
+      }
+      out << "}";
+    }
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  out << "\n]}\n";
+
+  if (dropped != 0) {
+    std::cerr << "Trace buffers overflow, " << dropped << " events are lost"
+              << std::endl;
+  }
+  std::cerr << "Trace is saved to '" << g_TraceFileName << "'" << std::endl;
+}
+
+#else
+
+bool Trace::Start(const std::string& fname) {
+  std::cerr << "Tracing is not supported by this build" << std::endl;
+  return false;
+}
+
+
+void Trace::Stop() {}
+
+#endif
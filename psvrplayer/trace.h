@@ -0,0 +1,105 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*! Трассировка событий всех потоков на одной временной шкале. События пишутся
+без блокировок в буферы потоков и при завершении трассировки сохраняются в
+файл формата Chrome trace (JSON), который открывается в chrome://tracing и
+Perfetto. Имена событий и счётчиков - строковые литералы: сохраняются только
+указатели на них.
+
+Без опции сборки PSVR_TRACING макросы TRACE_* не генерируют кода, а Start
+сообщает, что трассировка недоступна */
+namespace Trace {
+
+/*! Начать трассировку. Функция вызывается один раз, до создания рабочих
+потоков
+\param fname файл для сохранения трассировки
+\return признак, что трассировка включена */
+bool Start(const std::string& fname);
+
+/*! Завершить трассировку и сохранить события в файл. Если трассировка не
+включалась, то ничего не делается */
+void Stop();
+
+#ifdef PSVR_TRACING
+extern std::atomic_bool enabled_flag;  //!< Признак включённой трассировки
+
+/*! Признак включённой трассировки */
+inline bool IsEnabled() {
+  return enabled_flag.load(std::memory_order_relaxed);
+}
+
+/*! Выдать текущее время трассировки, нс */
+int64_t Now();
+
+/*! Задать имя текущего потока для трассировки */
+void SetThreadName(const std::string& name);
+
+/*! Записать событие с длительностью
+\param name имя события
+\param start время начала, нс (см. Now)
+\param end время окончания, нс */
+void Complete(const char* name, int64_t start, int64_t end);
+
+/*! Записать значение счётчика
+\param name имя счётчика
+\param value значение */
+void Counter(const char* name, double value);
+
+/*! Записать мгновенное событие
+\param name имя события */
+void Instant(const char* name);
+
+/*! Событие на время жизни объекта */
+class Scope {
+ public:
+  explicit Scope(const char* name)
+      : name_(name), start_(IsEnabled() ? Now() : -1) {}
+  ~Scope() {
+    if (start_ >= 0) {
+      Complete(name_, start_, Now());
+    }
+  }
+
+ private:
+  Scope(const Scope&) = delete;
+  Scope(Scope&&) = delete;
+  Scope& operator=(const Scope&) = delete;
+  Scope& operator=(Scope&&) = delete;
+
+  const char* name_;  //!< Имя события
+  int64_t start_;  //!< Время начала, нс. -1 - трассировка выключена
+};
+#endif
+
+}  // namespace Trace
+
+#ifdef PSVR_TRACING
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) \
+  do {                             \
+    if (Trace::IsEnabled()) {      \
+      Trace::Counter(name, value); \
+    }                              \
+  } while (false)
+#define TRACE_INSTANT(name)    \
+  do {                         \
+    if (Trace::IsEnabled()) {  \
+      Trace::Instant(name);    \
+    }                          \
+  } while (false)
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif  // TRACE_H
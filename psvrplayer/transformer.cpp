@@ -2,8 +2,10 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cassert>
 #include <condition_variable>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -25,8 +27,13 @@
 #include <glm/gtx/rotate_vector.hpp>
 
 #include "frame_buffer.h"
+#include "frame_pacing.h"
+#include "metrics.h"
 #include "play_screen.h"
+#include "profiled_mutex.h"
 #include "shader_program.h"
+#include "thread_policy.h"
+#include "trace.h"
 #include "vr_helmet.h"
 #include "shaders/flat.vert.h"
 #include "shaders/flat.frag.h"
@@ -47,6 +54,12 @@ struct VertexArray {
 
 // const double kPi = 3.1415926535897932384626433832795;
 
+// Точки привязки блоков uniform-переменных
+const unsigned int kFrameBinding = 0;  //!< Блок FrameParameters
+const unsigned int kEyeBinding = 1;  //!< Блок EyeParameters
+const size_t kEyeBlocksAmount =
+    2;  //!< Количество блоков EyeParameters (по одному на выход SplitScreen)
+
 
 class GlProgramm: public Transformer {
  public:
@@ -58,6 +71,8 @@ class GlProgramm: public Transformer {
   void SetEyeSwap(bool swap) override;
   void SetViewPoint(float x_disp, float y_disp) override;
   void SetEyesDistance(int distance) override;
+  void SetFramePacing(double frame_rate, int refresh_rate) override;
+  void SetIdle(bool idle) override;
 
  private:
   GlProgramm() = delete;
@@ -69,6 +84,25 @@ class GlProgramm: public Transformer {
   // TODO description???
   enum SplitScheme { kSplitSingleImage, kSplitLeftRight, kSplitUpDown };
 
+  // Индексы uniform-переменных выходной программы
+  enum OutputUniforms { kOutputLeftImage, kOutputRightImage };
+
+  /*! Параметры кадра для блока FrameParameters в шейдерах. Раскладка std140,
+  поэтому порядок и выравнивание полей должны совпадать с шейдерами */
+  struct FrameUniforms {
+    float transformation[16];  //!< Матрица трансформации (хранится как в glm)
+    float width2height;  //!< Отношение ширины к высоте изображения
+    float image_width;  //!< Реальная ширина изображения (в долях) от полной
+    float eyes_correction;  //!< Корректировка глазного расстояния
+    float padding;
+  };
+
+  /*! Параметры глаза для блока EyeParameters в шейдерах. Раскладка std140 */
+  struct EyeUniforms {
+    int32_t part_index;  //!< Часть входного изображения (см. split.frag)
+    int32_t padding[3];
+  };
+
   // Описание всех параметров для построения сцены
   // Заполняется и используется только в потоке трансформации и отображения
   struct SceneParameters {
@@ -97,48 +131,84 @@ class GlProgramm: public Transformer {
   std::shared_ptr<IHelmet> helmet_;
 
   std::vector<Frame> last_frames_;
-  std::mutex last_frames_lock_;
+  ProfiledMutex last_frames_lock_;
   bool swap_eyes_setting_;  //!< Настройка по смене порядка изображений для
                             //!< глаз. Настройка под блокировкой update_lock_
   float eyes_correction_;  //!< Корректировка глазного расстояния. Под
                            //!< блокировкой update_lock_
   float x_angle_;
   float y_angle_;
+  double frame_rate_;  //!< Частота кадров фильма. Под блокировкой update_lock_
+  int refresh_rate_;  //!< Частота обновления экрана. Под блокировкой
+                      //!< update_lock_
+  bool pacing_changed_;  //!< Признак изменения частот. Под блокировкой
+                         //!< update_lock_
+  bool idle_;  //!< Экономный режим отрисовки. Под блокировкой update_lock_
+
+  const std::chrono::milliseconds kIdleRenderInterval{
+      250};  //!< Интервал перерисовки в экономном режиме
 
   // Переменная обновления работает в два флага: shutdown_flag_ и не пустой
   // last_frames_ last_frames_ не под блокировкой переменной (update_lock_),
   // поэтому нужно проверять каждый раз
-  std::condition_variable update_var_;
+  ProfiledConditionVariable update_var_;
   bool shutdown_flag_;
-  std::mutex update_lock_;
+  ProfiledMutex update_lock_;
 
   // Переменные для работы только в функциях процессинга
-  unsigned int split_program_;
-  unsigned int half_cilinder_program_;
-  unsigned int flat_program_;
+  ShaderProgram split_program_;
+  ShaderProgram half_cilinder_program_;
+  ShaderProgram flat_program_;
+  ShaderProgram output_program_;
   glm::mat4 projection_matrix_;  //!< Проекционная матрица
   VertexArray cube_vertex_;  //!< Вершины для кубической сцены (формирование
                              //!< полусфер и т.д.)
   VertexArray flat_vertex_;  //!< Вершины для плоской сцены (вывод изображений)
+  unsigned int bound_vertex_;  //!< Текущий привязанный массив вершин
+  unsigned int uniform_buffer_;  //!< Буфер с блоками uniform-переменных
+  size_t eye_block_offset_;  //!< Смещение первого блока EyeParameters в буфере
+  size_t eye_block_stride_;  //!< Шаг между блоками EyeParameters в буфере
+  std::vector<uint8_t> uniform_data_;  //!< Данные буфера uniform-переменных
 
   void Processing();
 
-  // TODO ???
-  void SplitScreen(unsigned int texture, const FrameBuffer& left,
-      const FrameBuffer& right, unsigned int width, unsigned int aligned_width);
+  /*! Создать буфер uniform-переменных: блок кадра и блоки глаз с учётом
+  выравнивания смещений. Блок кадра сразу привязывается к kFrameBinding */
+  bool CreateUniformBuffer();
+
+  /*! Удалить буфер uniform-переменных */
+  void DeleteUniformBuffer();
+
+  /*! Заполнить и загрузить в буфер все параметры кадра и глаз. Вызывается
+  один раз на кадр, до отрисовки всех проходов */
+  void UpdateUniforms(const SceneParameters& params);
+
+  /*! Привязать блок глаза с индексом index к точке kEyeBinding */
+  void BindEyeBlock(size_t index);
+
+  /*! Привязать массив вершин, если он ещё не привязан */
+  void BindVertex(const VertexArray& vertex);
+
+  /*! Прогревочная отрисовка всеми программами до прихода первого кадра.
+  Драйвер может окончательно собирать шейдеры только при первой отрисовке,
+  поэтому делаем её заранее, чтобы не задерживать показ первого кадра */
+  void WarmUp(SceneParameters& params);
+
+  /*! Разделить входную текстуру на две части: в left идёт часть из первого
+  блока глаза, в right - из второго (см. UpdateUniforms) */
+  void SplitScreen(
+      unsigned int texture, const FrameBuffer& left, const FrameBuffer& right);
 
   /*! Отрисовать входной буфер (in_buffer) натянутым на цилиндрическую
   поверхность охватом в 180 градусов и результат выдать в выходной буфер
-  (out_buffer). Также применить повороты из матрицы трансформации (transform) */
-  void HalfCilinder(const FrameBuffer& in_buffer, const FrameBuffer& out_buffer,
-      const glm::mat4& transform);
+  (out_buffer). Повороты берутся из матрицы трансформации блока кадра */
+  void HalfCilinder(
+      const FrameBuffer& in_buffer, const FrameBuffer& out_buffer);
 
   /*! Отрисовать входной буфер (in_buffer) натянутым на плоскость и
-  результат выдать в выходной буфер (out_buffer). Также применить повороты из
-  матрицы трансформации (transform)
-  \param width2height отношение ширины к высоте для рендеринга изображения */
-  void RenderFlat(const FrameBuffer& in_buffer, const FrameBuffer& out_buffer,
-      const glm::mat4& transform, double width2height);
+  результат выдать в выходной буфер (out_buffer). Повороты и отношение ширины к
+  высоте берутся из блока кадра */
+  void RenderFlat(const FrameBuffer& in_buffer, const FrameBuffer& out_buffer);
 
 
   /*! Удалить массив вершин */
@@ -174,11 +244,18 @@ TransformerPtr CreateTransformer(TransformerScheme scheme,
 
 GlProgramm::GlProgramm(TransformerScheme scheme, StreamsScheme streams,
     IPlayScreenPtr screen, std::shared_ptr<IHelmet> helmet)
-    : swap_eyes_setting_(false),
+    : last_frames_lock_("render_last_frames"),
+      swap_eyes_setting_(false),
       eyes_correction_(0.0f),
-      split_program_(0),
-      half_cilinder_program_(0),
-      flat_program_(0) {
+      frame_rate_(0.0),
+      refresh_rate_(0),
+      pacing_changed_(false),
+      idle_(false),
+      update_lock_("render_update"),
+      bound_vertex_(0),
+      uniform_buffer_(0),
+      eye_block_offset_(0),
+      eye_block_stride_(0) {
   scheme_settings_ = scheme;
   streams_settings_ = streams;
   screen_ = screen;
@@ -198,57 +275,73 @@ GlProgramm::GlProgramm(TransformerScheme scheme, StreamsScheme streams,
 }
 
 
-// TODO Отладка
-static float minx = 0;
-static float maxx = 0;
-
-
 GlProgramm::~GlProgramm() {
-  std::unique_lock<std::mutex> lk(update_lock_);
+  ProfiledLock lk(update_lock_);
   shutdown_flag_ = true;
   update_var_.notify_all();
   lk.unlock();
   if (transform_thread_.joinable()) {
     transform_thread_.join();
   }
-
-  std::cout << "Mouse x range: " << minx << " - " << maxx << std::endl;
 }
 
 void GlProgramm::SetImage(Frame&& frame) {
-  std::unique_lock<std::mutex> fr_lock(last_frames_lock_);
+  std::unique_lock<ProfiledMutex> fr_lock(last_frames_lock_);
   last_frames_.push_back(std::move(frame));
   fr_lock.unlock();
   update_var_.notify_all();
 }
 
 void GlProgramm::SetEyeSwap(bool swap) {
-  std::unique_lock<std::mutex> lk(update_lock_);
+  ProfiledLock lk(update_lock_);
   swap_eyes_setting_ = swap;
 }
 
 void GlProgramm::SetViewPoint(float x_disp, float y_disp) {
-  std::unique_lock<std::mutex> lk(update_lock_);
+  ProfiledLock lk(update_lock_);
   x_angle_ = x_disp;
   y_angle_ = y_disp;
-
-  // TODO отладка
-  if (x_angle_ < minx) {
-    minx = x_angle_;
-  }
-  if (x_angle_ > maxx) {
-    maxx = x_angle_;
-  }
 }
 
 void GlProgramm::SetEyesDistance(int distance) {
-  std::unique_lock<std::mutex> lk(update_lock_);
+  ProfiledLock lk(update_lock_);
   eyes_correction_ = (66 - distance) / 72.0f;
 }
 
+void GlProgramm::SetFramePacing(double frame_rate, int refresh_rate) {
+  ProfiledLock lk(update_lock_);
+  frame_rate_ = frame_rate;
+  refresh_rate_ = refresh_rate;
+  pacing_changed_ = true;
+  lk.unlock();
+  update_var_.notify_all();
+}
+
+void GlProgramm::SetIdle(bool idle) {
+  ProfiledLock lk(update_lock_);
+  if (idle_ == idle) {
+    return;
+  }
+  idle_ = idle;
+  // Фаза развёртки за время простоя не отслеживалась: расписание строится
+  // заново
+  pacing_changed_ = true;
+  lk.unlock();
+  update_var_.notify_all();
+}
+
+
 void GlProgramm::Processing() {
   SceneParameters params;
-
+  FramePacing pacing;
+  bool has_image = false;  //!< Признак, что во входной текстуре есть кадр
+  auto& render_latency = Metrics::GetHistogram("render_wakeup_us");
+  auto& frame_time = Metrics::GetHistogram("frame_time_us");
+  auto& frames_uploaded = Metrics::GetCounter("frames_uploaded");
+  auto& frames_dropped = Metrics::GetCounter("frames_dropped");
+  auto& frames_presented = Metrics::GetCounter("frames_presented");
+
+  SetupThread("render");
   screen_->MakeScreenCurrent();
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     std::cerr << "Can't initialize Glad context. Maybe a logic error: make "
@@ -269,29 +362,40 @@ void GlProgramm::Processing() {
     throw std::runtime_error("Can't initialize scene framebuffers");
   }
 
-  if (!CreateShaderProgram(split_program_, shaders_split_vert,
-          shaders_split_vert_len, shaders_split_frag, shaders_split_frag_len)) {
+  const std::vector<std::pair<std::string, unsigned int>> blocks = {
+      {"FrameParameters", kFrameBinding}, {"EyeParameters", kEyeBinding}};
+
+  if (!split_program_.Create(shaders_split_vert, shaders_split_vert_len,
+          shaders_split_frag, shaders_split_frag_len, {}, blocks)) {
     throw std::runtime_error("Can't create split program");
   }
 
-  if (!CreateShaderProgram(half_cilinder_program_, shaders_halfcilinder_vert,
+  if (!half_cilinder_program_.Create(shaders_halfcilinder_vert,
           shaders_halfcilinder_vert_len, shaders_halfcilinder_frag,
-          shaders_halfcilinder_frag_len)) {
+          shaders_halfcilinder_frag_len, {}, blocks)) {
     throw std::runtime_error("Can't create half cilinder program");
   }
 
-  if (!CreateShaderProgram(flat_program_, shaders_flat_vert,
-          shaders_flat_vert_len, shaders_flat_frag, shaders_flat_frag_len)) {
+  if (!flat_program_.Create(shaders_flat_vert, shaders_flat_vert_len,
+          shaders_flat_frag, shaders_flat_frag_len, {}, blocks)) {
     throw std::runtime_error("Can't create flat program");
   }
 
-  unsigned int output_program;
-  if (!CreateShaderProgram(output_program, shaders_output_vert,
-          shaders_output_vert_len, shaders_output_frag,
-          shaders_output_frag_len)) {
+  if (!output_program_.Create(shaders_output_vert, shaders_output_vert_len,
+          shaders_output_frag, shaders_output_frag_len,
+          {"left_image", "right_image"}, blocks)) {
     throw std::runtime_error("Can't create output program");
   }
 
+  // Текстурные блоки выходной программы не меняются, выставим их один раз
+  output_program_.Use();
+  glUniform1i(output_program_.Location(kOutputLeftImage), 0);
+  glUniform1i(output_program_.Location(kOutputRightImage), 1);
+
+  if (!CreateUniformBuffer()) {
+    throw std::runtime_error("Can't create uniform buffer");
+  }
+
   if (!CreateCubeVertex(cube_vertex_)) {
     throw std::runtime_error("Can't create cube scene");
   }
@@ -314,52 +418,97 @@ void GlProgramm::Processing() {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glBindTexture(GL_TEXTURE_2D, 0);
 
+  WarmUp(params);
+
   while (true) {
-    std::unique_lock<std::mutex> lk(update_lock_);
+    ProfiledLock lk(update_lock_);
     if (shutdown_flag_) {
       break;
     }
-    update_var_.wait(lk);
+    // По расписанию отрисовка идёт на каждой развёртке и начинается
+    // непосредственно перед ней, иначе - только по приходу кадра. В экономном
+    // режиме сцена только изредка обновляется последним кадром
+    if (idle_) {
+      update_var_.wait_for(lk, kIdleRenderInterval,
+          [this] { return shutdown_flag_ || !idle_; });
+    } else if (!pacing.IsEnabled() || !has_image) {
+      update_var_.wait(lk);
+    } else {
+      auto render_start = pacing.GetRenderStart();
+      if (!update_var_.wait_until(
+              lk, render_start, [this] { return shutdown_flag_; })) {
+        render_latency.Add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                FramePacing::Clock::now() - render_start)
+                .count());
+      }
+    }
     if (shutdown_flag_) {
       break;
     }
+    bool idle = idle_;
     params.swap_eyes = swap_eyes_setting_;
     params.scheme = scheme_settings_;
     params.eyes_correction = eyes_correction_;
+    if (pacing_changed_) {
+      pacing.SetRates(frame_rate_, refresh_rate_);
+      pacing_changed_ = false;
+    }
     lk.unlock();
 
-    if (helmet_) {
+    TRACE_SCOPE("RenderFrame");
+    auto frame_start = FramePacing::Clock::now();
+    if (!idle) {
+      pacing.OnRenderStart(frame_start);
+    }
+    if (helmet_ && pacing.IsEnabled() && !idle) {
+      // Положение шлема на момент показа кадра
+      helmet_->GetViewPointAt(
+          pacing.GetDisplayTime(), params.rotation_matrix);
+    } else if (helmet_) {
       helmet_->GetViewPoint(params.rotation_matrix);
     } else {
       params.rotation_matrix = glm::mat4(1);
     }
 
-    // Вытащим все пришедшие кадры, их может и не быть (ложное слетание с wait)
-    std::vector<Frame> last;
-    std::unique_lock<std::mutex> fl(last_frames_lock_);
-    std::swap(last, last_frames_);
-    fl.unlock();
-
-    if (last.empty()) {
-      continue;
-    }
-
-    // Выбираем последний кадр в работу. Остальные возвращаем в пул
-    Frame frame = std::move(last.back());
-    last.pop_back();
-    while (!last.empty()) {
-      ReleaseFrame(std::move(last.back()));
-      last.pop_back();
+    if (idle || pacing.IsFrameDue()) {
+      // Вытащим все пришедшие кадры, их может и не быть (ложное слетание с
+      // wait или кадр ещё не пришёл)
+      std::vector<Frame> last;
+      std::unique_lock<ProfiledMutex> fl(last_frames_lock_);
+      std::swap(last, last_frames_);
+      fl.unlock();
+      TRACE_COUNTER("QueuedFrames", double(last.size()));
+
+      if (!last.empty()) {
+        // Выбираем последний кадр в работу. Остальные возвращаем в пул
+        Frame frame = std::move(last.back());
+        last.pop_back();
+        pacing.OnFrameShown(last.size());
+        frames_dropped.Add(last.size());
+        while (!last.empty()) {
+          ReleaseFrame(std::move(last.back()));
+          last.pop_back();
+        }
+
+        TRACE_SCOPE("UploadFrame");
+        glBindTexture(GL_TEXTURE_2D, params.input_texture);
+        frame.GetSizes(
+            &params.width, &params.height, &params.align_width, nullptr);
+        size_t data_size;
+        void* data = frame.GetData(data_size);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, params.align_width,
+            params.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        ReleaseFrame(std::move(frame));
+        frames_uploaded.Add();
+        has_image = true;
+      } else if (!pacing.IsEnabled() || !has_image) {
+        continue;
+      }
     }
 
-    glBindTexture(GL_TEXTURE_2D, params.input_texture);
-    frame.GetSizes(&params.width, &params.height, &params.align_width, nullptr);
-    size_t data_size;
-    void* data = frame.GetData(data_size);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, params.align_width, params.height, 0,
-        GL_BGRA, GL_UNSIGNED_BYTE, data);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    ReleaseFrame(std::move(frame));
+    UpdateUniforms(params);
 
     switch (params.scheme) {
       case kLeftRight180:
@@ -379,30 +528,37 @@ void GlProgramm::Processing() {
     screen_->GetFrameSize(scrw, scrh);
     glViewport(0, 0, scrw, scrh);
 
-    glUseProgram(output_program);
+    output_program_.Use();
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, params.left_scene.texture);
-    GLint loc = glGetUniformLocation(output_program, "left_image");
-    glUniform1i(loc, 0);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, params.right_scene.texture);
-    loc = glGetUniformLocation(output_program, "right_image");
-    glUniform1i(loc, 1);
     glActiveTexture(GL_TEXTURE0);
-    // eyes correction
-    loc = glGetUniformLocation(output_program, "eyes_correction");
-    glUniform1f(loc, params.eyes_correction);
 
     //    glBindTexture(GL_TEXTURE_2D, left_eye.texture);
-    glBindVertexArray(flat_vertex_.array_id);
+    BindVertex(flat_vertex_);
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     glDrawArrays(GL_TRIANGLES, 0, flat_vertex_.array_size);
 
     glBindTexture(GL_TEXTURE_2D, 0);
-    glBindVertexArray(0);
 
-    screen_->DisplayBuffer();
+    // Ожидание перед отрисовкой по расписанию ограничивает темп, даже если
+    // драйвер не ждёт развёртку при выводе буфера
+    if (!idle) {
+      pacing.OnRenderDone(FramePacing::Clock::now());
+    }
+    {
+      TRACE_SCOPE("SwapBuffers");
+      screen_->DisplayBuffer();
+    }
+    frames_presented.Add();
+    frame_time.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+        FramePacing::Clock::now() - frame_start)
+                       .count());
+    if (!idle) {
+      pacing.OnSwap(FramePacing::Clock::now());
+    }
   }
 
   glDeleteTextures(1, &params.input_texture);
@@ -411,115 +567,196 @@ void GlProgramm::Processing() {
   DeleteFrameBuffer(params.right_eye);
   DeleteFrameBuffer(params.left_scene);
   DeleteFrameBuffer(params.right_scene);
-  DeleteShaderProgram(flat_program_);
-  DeleteShaderProgram(split_program_);
-  DeleteShaderProgram(half_cilinder_program_);
-  DeleteShaderProgram(output_program);
+  flat_program_.Delete();
+  split_program_.Delete();
+  half_cilinder_program_.Delete();
+  output_program_.Delete();
+  DeleteUniformBuffer();
 
   DeleteVertex(cube_vertex_);
   DeleteVertex(flat_vertex_);
 }
 
-void GlProgramm::SplitScreen(unsigned int texture, const FrameBuffer& left,
-    const FrameBuffer& right, unsigned int width, unsigned int aligned_width) {
-  // Разделим текстуру на две
-  GLint loc;
-  GLint left_sc, right_sc;
+bool GlProgramm::CreateUniformBuffer() {
+  GLint align = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+  size_t a = align > 0 ? size_t(align) : 1;
+  eye_block_offset_ = (sizeof(FrameUniforms) + a - 1) / a * a;
+  eye_block_stride_ = (sizeof(EyeUniforms) + a - 1) / a * a;
+  uniform_data_.assign(
+      eye_block_offset_ + eye_block_stride_ * kEyeBlocksAmount, 0);
+
+  glGenBuffers(1, &uniform_buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, uniform_data_.size(), nullptr,
+      GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  if (glGetError() != GL_NO_ERROR) {
+    return false;
+  }
 
+  glBindBufferRange(GL_UNIFORM_BUFFER, kFrameBinding, uniform_buffer_, 0,
+      sizeof(FrameUniforms));
+  BindEyeBlock(0);
+  return true;
+}
+
+
+void GlProgramm::DeleteUniformBuffer() {
+  glDeleteBuffers(1, &uniform_buffer_);
+  uniform_buffer_ = 0;
+}
+
+
+void GlProgramm::UpdateUniforms(const SceneParameters& params) {
+  FrameUniforms fu;
+  glm::mat4 transform = projection_matrix_ * params.rotation_matrix;
+  std::memcpy(fu.transformation, glm::value_ptr(transform),
+      sizeof(fu.transformation));
+  fu.width2height = float(params.width) / float(params.height);
+  fu.image_width = float(params.width) / float(params.align_width);
+  fu.eyes_correction = params.eyes_correction;
+  fu.padding = 0.0f;
+  std::memcpy(uniform_data_.data(), &fu, sizeof(fu));
+
+  // Порядок глаз (swap_eyes) учитывается в схемах порядком выходных буферов
+  EyeUniforms eu[kEyeBlocksAmount] = {};
   switch (streams_settings_) {
     case kLeftRightStreams:
-      left_sc = 0;
-      right_sc = 1;
+      eu[0].part_index = 0;
+      eu[1].part_index = 1;
       break;
     case kUpDownStreams:
-      left_sc = 2;
-      right_sc = 3;
+      eu[0].part_index = 2;
+      eu[1].part_index = 3;
       break;
     case kSingleStream:
-      left_sc = 100;
-      right_sc = 100;
+      eu[0].part_index = 100;
+      eu[1].part_index = 100;
       break;
   }
+  for (size_t i = 0; i < kEyeBlocksAmount; ++i) {
+    auto offset = eye_block_offset_ + i * eye_block_stride_;
+    std::memcpy(uniform_data_.data() + offset, &eu[i], sizeof(eu[i]));
+  }
 
-  // Левая
-  glBindFramebuffer(GL_FRAMEBUFFER, left.buffer);
-  glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
-  glUseProgram(split_program_);
+  glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer_);
+  glBufferSubData(
+      GL_UNIFORM_BUFFER, 0, uniform_data_.size(), uniform_data_.data());
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-  loc = glGetUniformLocation(split_program_, "part_index");
-  glUniform1i(loc, left_sc);
 
-  loc = glGetUniformLocation(split_program_, "image_width");
-  glUniform1f(loc, float(width) / aligned_width);
+void GlProgramm::BindEyeBlock(size_t index) {
+  assert(index < kEyeBlocksAmount);
+  glBindBufferRange(GL_UNIFORM_BUFFER, kEyeBinding, uniform_buffer_,
+      eye_block_offset_ + index * eye_block_stride_, sizeof(EyeUniforms));
+}
 
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glBindVertexArray(flat_vertex_.array_id);
+
+void GlProgramm::BindVertex(const VertexArray& vertex) {
+  if (bound_vertex_ == vertex.array_id) {
+    return;
+  }
+  glBindVertexArray(vertex.array_id);
+  bound_vertex_ = vertex.array_id;
+}
+
+
+void GlProgramm::WarmUp(SceneParameters& params) {
+  // Пустое входное изображение 1x1
+  const uint32_t black = 0;
+  glBindTexture(GL_TEXTURE_2D, params.input_texture);
+  glTexImage2D(
+      GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, &black);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  params.width = params.height = params.align_width = 1;
+  params.eyes_correction = 0.0f;
+  params.rotation_matrix = glm::mat4(1);
+  UpdateUniforms(params);
+
+  SplitScreen(params.input_texture, params.left_eye, params.right_eye);
+  HalfCilinder(params.left_eye, params.left_scene);
+  RenderFlat(params.right_eye, params.right_scene);
+
+  output_program_.Use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, params.left_scene.texture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, params.right_scene.texture);
+  glActiveTexture(GL_TEXTURE0);
+  BindVertex(flat_vertex_);
   glDrawArrays(GL_TRIANGLES, 0, flat_vertex_.array_size);
   glBindTexture(GL_TEXTURE_2D, 0);
-  glBindVertexArray(0);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  // Правая
-  glBindFramebuffer(GL_FRAMEBUFFER, right.buffer);
-  glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
-  glUseProgram(split_program_);
+  // Дожидаемся окончания сборки и отрисовки. Буфер на экран не выводим
+  glFinish();
+}
+
+
+void GlProgramm::SplitScreen(
+    unsigned int texture, const FrameBuffer& left, const FrameBuffer& right) {
+  // Разделим текстуру на две
+  split_program_.Use();
+  BindVertex(flat_vertex_);
   glBindTexture(GL_TEXTURE_2D, texture);
 
-  loc = glGetUniformLocation(split_program_, "part_index");
-  glUniform1i(loc, right_sc);
+  // Левая
+  BindEyeBlock(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, left.buffer);
+  glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
+  glDrawArrays(GL_TRIANGLES, 0, flat_vertex_.array_size);
 
-  glBindVertexArray(flat_vertex_.array_id);
+  // Правая
+  BindEyeBlock(1);
+  glBindFramebuffer(GL_FRAMEBUFFER, right.buffer);
+  glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
   glDrawArrays(GL_TRIANGLES, 0, flat_vertex_.array_size);
+
   glBindTexture(GL_TEXTURE_2D, 0);
-  glBindVertexArray(0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void GlProgramm::HalfCilinder(const FrameBuffer& in_buffer,
-    const FrameBuffer& out_buffer, const glm::mat4& transform) {
+void GlProgramm::HalfCilinder(
+    const FrameBuffer& in_buffer, const FrameBuffer& out_buffer) {
   glBindFramebuffer(GL_FRAMEBUFFER, out_buffer.buffer);
   glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
   glClearColor(0, 0, 0, 0);
   glClear(GL_COLOR_BUFFER_BIT);
-  glUseProgram(half_cilinder_program_);
+  half_cilinder_program_.Use();
   glBindTexture(GL_TEXTURE_2D, in_buffer.texture);
-  auto tr_var = glGetUniformLocation(half_cilinder_program_, "transformation");
-  glUniformMatrix4fv(tr_var, 1, GL_TRUE, glm::value_ptr(transform));
 
-  glBindVertexArray(cube_vertex_.array_id);
+  BindVertex(cube_vertex_);
   //      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   glDrawArrays(GL_TRIANGLES, 0, cube_vertex_.array_size);
   //      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   glBindTexture(GL_TEXTURE_2D, 0);
-  glBindVertexArray(0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
-void GlProgramm::RenderFlat(const FrameBuffer& in_buffer,
-    const FrameBuffer& out_buffer, const glm::mat4& transform,
-    double width2height) {
+void GlProgramm::RenderFlat(
+    const FrameBuffer& in_buffer, const FrameBuffer& out_buffer) {
   glBindFramebuffer(GL_FRAMEBUFFER, out_buffer.buffer);
   glViewport(0, 0, FrameBuffer::texture_size, FrameBuffer::texture_size);
   glClearColor(0, 0, 0, 0);
   glClear(GL_COLOR_BUFFER_BIT);
-  glUseProgram(flat_program_);
+  flat_program_.Use();
   glBindTexture(GL_TEXTURE_2D, in_buffer.texture);
-  auto tr_var = glGetUniformLocation(flat_program_, "transformation");
-  glUniformMatrix4fv(tr_var, 1, GL_TRUE, glm::value_ptr(transform));
-  tr_var = glGetUniformLocation(flat_program_, "width2height");
-  assert(tr_var != -1);
-  glUniform1f(tr_var, (float)width2height);
 
-  glBindVertexArray(cube_vertex_.array_id);
+  BindVertex(cube_vertex_);
   glDrawArrays(GL_TRIANGLES, 0, cube_vertex_.array_size);
   glBindTexture(GL_TEXTURE_2D, 0);
-  glBindVertexArray(0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
 void GlProgramm::DeleteVertex(VertexArray& vertex) {
+  if (bound_vertex_ == vertex.array_id) {
+    glBindVertexArray(0);
+    bound_vertex_ = 0;
+  }
   glDeleteVertexArrays(1, &vertex.array_id);
   vertex.array_id = 0;
   vertex.array_size = 0;
@@ -609,37 +846,26 @@ bool GlProgramm::CreateFlatVertex(VertexArray& vertex) {
 
 void GlProgramm::SchemeLeftRight180(const SceneParameters& params) {
   if (params.swap_eyes) {
-    SplitScreen(params.input_texture, params.right_eye, params.left_eye,
-        params.width, params.align_width);
+    SplitScreen(params.input_texture, params.right_eye, params.left_eye);
   } else {
-    SplitScreen(params.input_texture, params.left_eye, params.right_eye,
-        params.width, params.align_width);
+    SplitScreen(params.input_texture, params.left_eye, params.right_eye);
   }
 
-  auto transform = projection_matrix_ * params.rotation_matrix;
-
-  HalfCilinder(params.left_eye, params.left_scene, transform);
-  HalfCilinder(params.right_eye, params.right_scene, transform);
+  HalfCilinder(params.left_eye, params.left_scene);
+  HalfCilinder(params.right_eye, params.right_scene);
 }
 
 void GlProgramm::SchemeSingleImage(const GlProgramm::SceneParameters& params) {
-  SplitScreen(params.input_texture, params.left_scene, params.right_scene,
-      params.width, params.align_width);
+  SplitScreen(params.input_texture, params.left_scene, params.right_scene);
 }
 
 void GlProgramm::SchemeFlat3D(const GlProgramm::SceneParameters& params) {
   if (params.swap_eyes) {
-    SplitScreen(params.input_texture, params.right_eye, params.left_eye,
-        params.width, params.align_width);
+    SplitScreen(params.input_texture, params.right_eye, params.left_eye);
   } else {
-    SplitScreen(params.input_texture, params.left_eye, params.right_eye,
-        params.width, params.align_width);
+    SplitScreen(params.input_texture, params.left_eye, params.right_eye);
   }
 
-  auto transform = projection_matrix_ * params.rotation_matrix;
-
-  auto w2h = double(params.width) / double(params.height);
-
-  RenderFlat(params.left_eye, params.left_scene, transform, w2h);
-  RenderFlat(params.right_eye, params.right_scene, transform, w2h);
+  RenderFlat(params.left_eye, params.left_scene);
+  RenderFlat(params.right_eye, params.right_scene);
 }
@@ -39,6 +39,19 @@ class Transformer {
   /*! Выставить межглазное расстояние в условных миллиметрах
   \param delta межглазное расстояние в условных миллиметрах */
   virtual void SetEyesDistance(int distance) = 0;
+
+  /*! Включить показ кадров фильма по расписанию кадровой развёртки экрана.
+  При включённом расписании сцена перерисовывается на каждой развёртке, а
+  кадры фильма сменяются через равное количество развёрток
+  \param frame_rate частота кадров фильма. 0 - выключить расписание
+  \param refresh_rate частота обновления экрана в Гц */
+  virtual void SetFramePacing(double frame_rate, int refresh_rate) = 0;
+
+  /*! Включить экономный режим, например, когда шлем снят. В экономном режиме
+  сцена перерисовывается изредка и без расписания развёртки. При выключении
+  отрисовка сразу возвращается к обычному темпу
+  \param idle признак экономного режима */
+  virtual void SetIdle(bool idle) = 0;
 };
 
 using TransformerPtr = std::shared_ptr<Transformer>;
@@ -8,6 +8,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -18,6 +19,11 @@
 #endif
 
 #include "framepool.h"
+#include "metrics.h"
+#include "profiled_mutex.h"
+#include "synthetic_video_player.h"
+#include "thread_policy.h"
+#include "trace.h"
 
 
 /*! Класс для проигрывания видеофайла: открывает файл, выдаёт очередной кадр,
@@ -31,6 +37,8 @@ class VideoPlayer: public IVideoPlayer {
   bool OpenMovie(const std::string& filename) override;
   void CloseMovie() override;
   IVideoPlayer::MovieState GetMovieState() override;
+  IVideoPlayer::MovieState WaitMovieParsed() override;
+  double GetFrameRate() override;
   bool Play() override;
   void SetDisplayFn(std::function<void(Frame&&)> fn) override;
   void Pause(bool pause) override;
@@ -55,7 +63,7 @@ class VideoPlayer: public IVideoPlayer {
   libvlc_instance_t* lib_vlc_;
   libvlc_media_t* movie_media_;
   libvlc_media_player_t* movie_player_;
-  std::mutex lib_lock_;  //!< Блокировка на доступ к объектам vlc библиотеки
+  ProfiledMutex lib_lock_;  //!< Блокировка на доступ к объектам vlc библиотеки
 
   // Переменные из колбэков vlc lib
   unsigned
@@ -65,24 +73,30 @@ class VideoPlayer: public IVideoPlayer {
   unsigned video_lines_amount_;  //!< Количество линии. Должно быть кратна 32
 
   std::atomic<IVideoPlayer::MovieState> movie_state_;
+  std::condition_variable
+      parsed_var_;  //!< Событие окончания разбора файла (смены movie_state_)
+  std::mutex parsed_lock_;  //!< Блокировка для события parsed_var_
 
   unsigned video_width_;  //!< Ширина видеопотока в пикселях
   unsigned video_height_;  //!< Высота видеопотока в пикселях
   std::function<void(Frame&&)> on_display_;
-  std::mutex on_display_lock_;
+  ProfiledMutex on_display_lock_;
 
   // Функционал фреймов используется для асинхронной выдачи фреймов:
   // готовится фрейм в одном месте, вызов на отображение идёт в другом месте
   // Теоретически возможно, что vlc подготовит сразу несколько фреймов и потом
   // выдаст команды на вывод вразнобой.
   std::vector<Frame> frames_;
-  std::mutex frames_lock_;
+  ProfiledMutex frames_lock_;
 
 
   /*! Закрыть видеофайл. Внутренняя реализация без привязки в интерфейсу
    * IVideoPlayer */
   void CloseMovieIntr();
 
+  /*! Выставить состояние файла и оповестить ожидающих в WaitMovieParsed */
+  void SetMovieState(IVideoPlayer::MovieState state);
+
   void OnMediaParsed(const struct libvlc_event_t* p_event);
 
   void* OnVideoBufferLock(void** planes);
@@ -126,6 +140,19 @@ class VideoPlayer: public IVideoPlayer {
 };
 
 
+void PrepareVideoPlayer() {
+  // OS specific requirements for vlc library
+#ifdef FIX_POSIX_SIGNAL
+  // Linux code
+  sigset_t sg;
+  signal(SIGCHLD, SIG_DFL);
+  sigemptyset(&sg);
+  sigaddset(&sg, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sg, NULL);
+#endif
+}
+
+
 IVideoPlayerPtr CreateVideoPlayer() {
   try {
     return std::shared_ptr<IVideoPlayer>(new VideoPlayer());
@@ -138,26 +165,29 @@ IVideoPlayerPtr CreateVideoPlayer() {
 }
 
 
+IVideoPlayerPtr CreateSyntheticVideoPlayer() {
+  try {
+    return std::make_shared<SyntheticVideoPlayer>();
+  } catch (std::bad_alloc&) {
+    std::cerr << "ERROR: Lack of memory" << std::endl;
+  }
+  return IVideoPlayerPtr();
+}
+
+
 VideoPlayer::VideoPlayer()
     : lib_vlc_(nullptr),
       movie_media_(nullptr),
       movie_player_(nullptr),
+      lib_lock_("video_lib"),
       video_line_size_(0),
       video_line_width_(0),
       video_lines_amount_(0),
       movie_state_(IVideoPlayer::MovieState::kNoMovie),
       video_width_(0),
-      video_height_(0) {
-  // OS specific requirements for vlc library
-#ifdef FIX_POSIX_SIGNAL
-  // Linux code
-  sigset_t sg;
-  signal(SIGCHLD, SIG_DFL);
-  sigemptyset(&sg);
-  sigaddset(&sg, SIGPIPE);
-  pthread_sigmask(SIG_BLOCK, &sg, NULL);
-#endif
-
+      video_height_(0),
+      on_display_lock_("video_on_display"),
+      frames_lock_("video_frames") {
   lib_vlc_ = libvlc_new(0, nullptr);
   if (!lib_vlc_) {
     const char* msg = libvlc_errmsg();
@@ -201,7 +231,7 @@ VideoPlayer::~VideoPlayer() {
 
 bool VideoPlayer::OpenMovie(const std::string& filename) {
   int res;
-  std::unique_lock<std::mutex> lk(lib_lock_);
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
 
   if (movie_media_) {
     std::cerr << "ERROR: Other movie file is opened yet" << std::endl;
@@ -224,6 +254,9 @@ bool VideoPlayer::OpenMovie(const std::string& filename) {
     return false;
   }
 
+  // Состояние выставляется до запуска разбора: событие о его окончании
+  // может прийти раньше возврата из функции
+  SetMovieState(IVideoPlayer::MovieState::kMovieParsing);
   res = libvlc_media_parse_with_options(
       movie_media_, libvlc_media_parse_network, 0);
   if (res) {
@@ -232,9 +265,9 @@ bool VideoPlayer::OpenMovie(const std::string& filename) {
     if (msg) {
       std::cerr << "  Description: " << msg << std::endl;
     }
+    SetMovieState(IVideoPlayer::MovieState::kMovieFailed);
   }
 
-  movie_state_ = IVideoPlayer::MovieState::kMovieParsing;
   return true;
 }
 
@@ -245,9 +278,51 @@ void VideoPlayer::CloseMovie() { CloseMovieIntr(); }
 IVideoPlayer::MovieState VideoPlayer::GetMovieState() { return movie_state_; }
 
 
+IVideoPlayer::MovieState VideoPlayer::WaitMovieParsed() {
+  std::unique_lock<std::mutex> lk(parsed_lock_);
+  parsed_var_.wait(lk, [this]() {
+    return movie_state_ != IVideoPlayer::MovieState::kMovieParsing;
+  });
+  return movie_state_;
+}
+
+
+double VideoPlayer::GetFrameRate() {
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
+  if (!movie_media_ ||
+      movie_state_ != IVideoPlayer::MovieState::kMovieReadyToPlay) {
+    return 0.0;
+  }
+
+  double fps = 0.0;
+  libvlc_media_track_t** tracks;
+  unsigned amount = libvlc_media_tracks_get(movie_media_, &tracks);
+  for (unsigned i = 0; i < amount; ++i) {
+    auto t = tracks[i];
+    if (t->i_type == libvlc_track_video && t->video &&
+        t->video->i_frame_rate_den != 0) {
+      fps = double(t->video->i_frame_rate_num) / t->video->i_frame_rate_den;
+      break;
+    }
+  }
+  if (amount > 0) {
+    libvlc_media_tracks_release(tracks, amount);
+  }
+  return fps;
+}
+
+
+void VideoPlayer::SetMovieState(IVideoPlayer::MovieState state) {
+  std::unique_lock<std::mutex> lk(parsed_lock_);
+  movie_state_ = state;
+  lk.unlock();
+  parsed_var_.notify_all();
+}
+
+
 void VideoPlayer::CloseMovieIntr() {
   assert(movie_player_);
-  std::unique_lock<std::mutex> lk(lib_lock_);
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
   libvlc_media_player_stop(movie_player_);
 
   if (movie_media_) {
@@ -257,14 +332,14 @@ void VideoPlayer::CloseMovieIntr() {
     libvlc_media_release(movie_media_);
     movie_media_ = nullptr;
   }
-  movie_state_ = IVideoPlayer::MovieState::kNoMovie;
+  SetMovieState(IVideoPlayer::MovieState::kNoMovie);
 
   libvlc_media_player_set_media(movie_player_, nullptr);
 }
 
 
 bool VideoPlayer::Play() {
-  std::unique_lock<std::mutex> lk(lib_lock_);
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
   if (!movie_media_) {
     std::cerr << "Movie isn't opened" << std::endl;
     return false;
@@ -282,7 +357,7 @@ bool VideoPlayer::Play() {
     return false;
   }
 
-  std::unique_lock<std::mutex> lk1(on_display_lock_);
+  std::unique_lock<ProfiledMutex> lk1(on_display_lock_);
   video_width_ = w;
   video_height_ = h;
   lk1.unlock();
@@ -301,18 +376,18 @@ bool VideoPlayer::Play() {
 }
 
 void VideoPlayer::SetDisplayFn(std::function<void(Frame&&)> fn) {
-  std::lock_guard<std::mutex> lk(on_display_lock_);
+  std::lock_guard<ProfiledMutex> lk(on_display_lock_);
   on_display_ = fn;
 }
 
 void VideoPlayer::Pause(bool pause) {
-  std::unique_lock<std::mutex> lk(lib_lock_);
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
   libvlc_media_player_set_pause(movie_player_, pause);
 }
 
 
 void VideoPlayer::Move(int movement) {
-  std::unique_lock<std::mutex> lk(lib_lock_);
+  std::unique_lock<ProfiledMutex> lk(lib_lock_);
   auto len = libvlc_media_player_get_length(movie_player_);
   if (len == -1) {
     return;
@@ -367,24 +442,33 @@ void VideoPlayer::OnMediaParsed(const libvlc_event_t* p_event) {
     case libvlc_media_parsed_status_failed:
     case libvlc_media_parsed_status_timeout:
       std::cerr << "Movie parsed with errors" << std::endl;
-      movie_state_ = IVideoPlayer::MovieState::kMovieFailed;
+      SetMovieState(IVideoPlayer::MovieState::kMovieFailed);
       break;
     case libvlc_media_parsed_status_done:
-      movie_state_ = IVideoPlayer::MovieState::kMovieReadyToPlay;
+      SetMovieState(IVideoPlayer::MovieState::kMovieReadyToPlay);
       break;
   }
 }
 
 
 void* VideoPlayer::OnVideoBufferLock(void** planes) {
+  // Поток вывода видео создаёт vlc, настраиваем его при первом обращении
+  static thread_local bool thread_ready = false;
+  if (!thread_ready) {
+    thread_ready = true;
+    SetupThread("video");
+  }
+  TRACE_SCOPE("VideoBufferLock");
+  static auto& overflows = Metrics::GetCounter("decoder_overflows");
+
   Frame fr = RequestFrame(video_line_width_, video_lines_amount_);
   fr.SetSize(video_width_, video_height_);
   size_t sz;
   *planes = fr.GetData(sz);
-  std::lock_guard<std::mutex> lk(frames_lock_);
+  std::lock_guard<ProfiledMutex> lk(frames_lock_);
   frames_.push_back(std::move(fr));
   if (frames_.size() > kFramePoolSizeAlarm) {
-    std::cerr << "Frame processing OVERFLOW" << std::endl;
+    overflows.Add();
   }
   return *planes;
 }
@@ -395,10 +479,13 @@ void VideoPlayer::OnVideoBufferUnlock(void*, void* const*) {}
 
 
 void VideoPlayer::OnVideoBufferDisplay(void* picture) {
+  TRACE_SCOPE("VideoBufferDisplay");
+  static auto& decoded = Metrics::GetCounter("frames_decoded");
+  decoded.Add();
   // Найдём фрейм по адресу блока данных
   // Все игрища с поиском, указателями и т.д.
   // нужны для корректной обработки схемы "у фрейма один владелец"
-  std::unique_lock<std::mutex> lk(frames_lock_);
+  std::unique_lock<ProfiledMutex> lk(frames_lock_);
   int index = -1;
   for (int i = 0; i < (int)frames_.size(); ++i) {
     Frame& fr = frames_[i];
@@ -418,7 +505,7 @@ void VideoPlayer::OnVideoBufferDisplay(void* picture) {
   frames_.erase(frames_.begin() + index);
   lk.unlock();
 
-  std::lock_guard<std::mutex> dl(on_display_lock_);
+  std::lock_guard<ProfiledMutex> dl(on_display_lock_);
   if (on_display_) {
     on_display_(std::move(fr));
   }
@@ -453,7 +540,7 @@ unsigned VideoPlayer::OnVideoFormat(char* chroma, unsigned* width,
 }
 
 void VideoPlayer::OnVideoCleanup() {
-  std::unique_lock<std::mutex> lk(frames_lock_);
+  std::unique_lock<ProfiledMutex> lk(frames_lock_);
   while (!frames_.empty()) {
     ReleaseFrame(std::move(frames_.back()));
     frames_.pop_back();
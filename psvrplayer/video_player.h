@@ -39,6 +39,19 @@ class IVideoPlayer {
   \return текущее состояние файла */
   virtual MovieState GetMovieState() = 0;
 
+  /*! Дождаться окончания разбора файла, открытого в OpenMovie. Функция
+  блокирующая, ожидание идёт по событию от библиотеки (без опроса). Если файл
+  не разбирается, то функция завершается сразу.
+  Функция потокобезопасная и не выбрасывает исключений.
+  \return состояние файла после разбора */
+  virtual MovieState WaitMovieParsed() = 0;
+
+  /*! Возвращает частоту кадров видеопотока. Частота известна только после
+  разбора файла (состояние kMovieReadyToPlay). Функция потокобезопасная и не
+  выбрасывает исключений.
+  \return частота кадров в кадрах в секунду. 0 - если частота неизвестна */
+  virtual double GetFrameRate() = 0;
+
   /*! Начинает воспроизведение файла. Файл должен быть открыт и успешно разобран
   (состояние kMovieReadyToPlay). Функция потокобезопасная и не выбрасывает
   исключений.
@@ -77,9 +90,21 @@ class IVideoPlayer {
 using IVideoPlayerPtr = std::shared_ptr<IVideoPlayer>;
 
 
+/*! Подготовить процесс к работе библиотеки vlc (настройка сигналов).
+Вызывается один раз в основном потоке до создания других потоков, т.к. маска
+сигналов наследуется создаваемыми потоками */
+void PrepareVideoPlayer();
+
+
 /*! Функция создания экземпляра видеопроигрывателя
 \return указатель на экземпляр класса видеопроигрывателя.\
 В случае ошибки возвращается пустой указатель. */
 IVideoPlayerPtr CreateVideoPlayer();
 
+/*! Создать искусственный проигрыватель, который рисует кадры сам (см.
+SyntheticVideoPlayer). Вместо имени файла в OpenMovie передаётся описание
+фильма
+\return указатель на экземпляр проигрывателя */
+IVideoPlayerPtr CreateSyntheticVideoPlayer();
+
 #endif  // VIDEOPLAYER_H
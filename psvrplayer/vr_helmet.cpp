@@ -39,6 +39,7 @@
 
 #include <hidapi.h>
 
+#include "synthetic_helmet.h"
 #include "vr_helmet_calibration.h"
 #include "vr_helmet_view.h"
 
@@ -47,7 +48,8 @@
 const int kCalibrationCheck_1 =
     300;  //!< интервал для проверки данных, в миллисекундах
 const int kCalibrationTimeout_1 =
-    30000;  //!< Интервал калибровки сенсоров шлема, в миллисекундах
+    30000;  //!< Максимальный интервал калибровки сенсоров шлема, в
+            //!< миллисекундах
 const int kCalibrationTimeTick = 100;  //!< Интервал обновления при калибровке
 
 
@@ -60,6 +62,15 @@ std::shared_ptr<IHelmet> CreateHelmetView() {
 }
 
 
+std::shared_ptr<IHelmet> CreateSyntheticHelmet(const std::string& script) {
+  try {
+    return std::shared_ptr<SyntheticHelmet>(new SyntheticHelmet(script));
+  } catch (...) {
+  }
+  return std::shared_ptr<IHelmet>();
+}
+
+
 int DoHelmetDeviceCalibration() {
   int res = 0;
   unsigned int cr = CtrlCLibrary::kErrorID;
@@ -92,7 +103,8 @@ int DoHelmetDeviceCalibration() {
       throw 1;
     }
 
-    while (!stop_event && summ < kCalibrationTimeout_1) {
+    // Калибровка завершается, как только оценка дрейфа станет точной
+    while (!stop_event && summ < kCalibrationTimeout_1 && !vr->IsConverged()) {
       std::this_thread::sleep_for(
           std::chrono::milliseconds(kCalibrationTimeTick));
       summ += kCalibrationTimeTick;
@@ -20,7 +20,10 @@
 #ifndef VR_HELMET_H
 #define VR_HELMET_H
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
 
 #include <glm/glm.hpp>
 
@@ -37,12 +40,30 @@ class IHelmet {
   virtual void CenterView() = 0;
   // TODO ?? description
   virtual void GetViewPoint(glm::mat4& rotation) = 0;
+  /*! Выдать положение шлема на заданный момент времени: из истории положений
+  или с экстраполяцией вперёд. Если истории нет, то выдаётся текущее положение
+  \param time момент времени, например, ожидаемое время показа кадра
+  \param rotation выдаваемая матрица поворота */
+  virtual void GetViewPointAt(
+      std::chrono::steady_clock::time_point time, glm::mat4& rotation) = 0;
   // TODO ?? description
   virtual void SetRotationSpeedup(double speedup) = 0;
+  /*! Задать функцию оповещения о надевании и снятии шлема. Функция вызывается
+  при смене состояния из отдельного потока (не из потока сенсоров), а если
+  состояние уже известно, то и сразу при задании. Пустая функция отключает
+  оповещения: после возврата прежняя функция уже не вызывается
+  \param fn функция с признаком, что шлем надет */
+  virtual void SetWornFn(std::function<void(bool worn)> fn) = 0;
 };
 
 std::shared_ptr<IHelmet> CreateHelmetView();
 
+/*! Создать искусственный шлем, движение которого задаётся сценарием (см.
+SyntheticHelmet)
+\param script сценарий движения
+\return шлем или пустой указатель при ошибке в сценарии */
+std::shared_ptr<IHelmet> CreateSyntheticHelmet(const std::string& script);
+
 int DoHelmetDeviceCalibration();
 
 #endif  // VR_HELMET_H
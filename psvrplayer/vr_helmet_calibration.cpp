@@ -1,21 +1,23 @@
 #include "vr_helmet_calibration.h"
 
+#include <cmath>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 
 #include <errno.h>
 
-#include "iniparser.h"
+#include "config_file.h"
 #include "home-dir.h"
 
 const char kConfigFileName[] = "/psvrplayer.cfg";
 
 PsvrHelmetCalibration::PsvrHelmetCalibration()
-    : to_right_summ_(0),
-      to_top_summ_(0),
-      to_clockwork_summ_(0),
-      data_counter_(0) {
+    : total_(),
+      block_(),
+      block_moved_(false),
+      data_counter_(0),
+      rejected_blocks_(0) {
   config_fname_ = HomeDirLibrary::GetDataDir();
   if (config_fname_.empty()) {
     // Путь для конфигурационных данных неопределён
@@ -42,51 +44,68 @@ PsvrHelmetCalibration::PsvrHelmetCalibration()
   }
 }
 
+
+PsvrHelmetCalibration::~PsvrHelmetCalibration() {
+  // Поток сенсоров обновляет статистику, поэтому останавливается до
+  // уничтожения полей
+  StopReading();
+}
+
+
+void PsvrHelmetCalibration::Statistics::Add(const double* values) {
+  ++count;
+  for (int i = 0; i < 3; ++i) {
+    double delta = values[i] - mean[i];
+    mean[i] += delta / count;
+    m2[i] += delta * (values[i] - mean[i]);
+  }
+}
+
+
+void PsvrHelmetCalibration::Statistics::Merge(const Statistics& other) {
+  if (other.count == 0) {
+    return;
+  }
+  int64_t n = count + other.count;
+  for (int i = 0; i < 3; ++i) {
+    double delta = other.mean[i] - mean[i];
+    mean[i] += delta * other.count / n;
+    m2[i] += other.m2[i] + delta * delta * count * other.count / n;
+  }
+  count = n;
+}
+
+
+double PsvrHelmetCalibration::Statistics::Variance(int axis) const {
+  return count > 1 ? m2[axis] / (count - 1) : 0.0;
+}
+
+
 bool PsvrHelmetCalibration::DoneCalibration() {
-  int64_t tr, tt, tc, dc;
   std::unique_lock<std::mutex> lk(data_lock_);
-  tr = to_right_summ_;
-  tt = to_top_summ_;
-  tc = to_clockwork_summ_;
-  dc = data_counter_;
+  Statistics st = total_;
+  int64_t rejected = rejected_blocks_;
   lk.unlock();
 
-  if (dc < kMinDataCount) {
+  if (rejected > 0) {
+    std::cout << "Helmet movement is detected, rejected intervals: " << rejected
+              << std::endl;
+  }
+
+  if (st.count < kMinDataCount) {
     std::cerr << "ERROR: Low data from helmet. Calibration failed" << std::endl;
     return false;
   }
 
-  auto dict = iniparser_load(config_fname_.c_str());
-  if (!dict) {
-    std::cerr << "Can't parse configuration file. Calibration failed"
+  double variances[3] = {st.Variance(0), st.Variance(1), st.Variance(2)};
+  if (!Config::SetCalibration(
+          st.mean[0], st.mean[1], st.mean[2], st.count, variances)) {
+    std::cerr << "Can't save configuration file. Calibration failed"
               << std::endl;
-  } else {
-    bool res = true;
-    auto str = std::to_string(tr / dc);
-    auto stt = std::to_string(tt / dc);
-    auto stc = std::to_string(tc / dc);
-    res = res && (iniparser_set(dict, "Calibration", nullptr) == 0);
-    res = res && (iniparser_set(dict, "Calibration:right", str.c_str()) == 0);
-    res = res && (iniparser_set(dict, "Calibration:top", stt.c_str()) == 0);
-    res = res && (iniparser_set(dict, "Calibration:clock", stc.c_str()) == 0);
-    if (!res) {
-      std::cerr << "Can't generate configuration file. Calibration failed"
-                << std::endl;
-    } else {
-      auto f = fopen(config_fname_.c_str(), "w+");
-      if (!f) {
-        std::cerr << "Can't open configuration file '" << config_fname_
-                  << "'. Calibration failed" << std::endl;
-      } else {
-        iniparser_dump_ini(dict, f);
-        fclose(f);
-        std::cout << "Calibration completed" << std::endl;
-        return true;
-      }
-    }
-    iniparser_freedict(dict);
+    return false;
   }
-  return false;
+  std::cout << "Calibration completed" << std::endl;
+  return true;
 }
 
 bool PsvrHelmetCalibration::IsDataAvailable() {
@@ -94,15 +113,61 @@ bool PsvrHelmetCalibration::IsDataAvailable() {
   std::unique_lock<std::mutex> lk(data_lock_);
   dc = data_counter_;
   lk.unlock();
-  return dc > kMinDataCount;
+  return dc > kBlockSize;
+}
+
+
+bool PsvrHelmetCalibration::IsConverged() {
+  std::unique_lock<std::mutex> lk(data_lock_);
+  Statistics st = total_;
+  lk.unlock();
+
+  if (st.count < kMinDataCount) {
+    return false;
+  }
+  // Стандартная ошибка среднего по каждой оси
+  for (int i = 0; i < 3; ++i) {
+    if (st.Variance(i) / st.count > kBiasPrecision * kBiasPrecision) {
+      return false;
+    }
+  }
+  return true;
 }
 
 
-void PsvrHelmetCalibration::OnSensorsData(
-    double to_right, double to_top, double to_clockwork, uint64_t) {
+void PsvrHelmetCalibration::OnSensorsBatch(
+    const SensorsSample* samples, size_t count) {
   std::lock_guard<std::mutex> lk(data_lock_);
-  to_right_summ_ += to_right * kFixedPointFactor;
-  to_top_summ_ += to_top * kFixedPointFactor;
-  to_clockwork_summ_ += to_clockwork * kFixedPointFactor;
-  ++data_counter_;
+  for (size_t i = 0; i < count; ++i) {
+    const SensorsSample& sample = samples[i];
+    const double values[3] = {
+        sample.to_right, sample.to_top, sample.to_clockwork};
+    block_.Add(values);
+    ++data_counter_;
+
+    double g = std::sqrt(sample.accel_right * sample.accel_right +
+                         sample.accel_top * sample.accel_top +
+                         sample.accel_forward * sample.accel_forward);
+    if (std::abs(g - 1.0) > kAccelTolerance) {
+      block_moved_ = true;
+    }
+
+    if (block_.count < kBlockSize) {
+      continue;
+    }
+    // Блок набран. Если шлем двигали, то блок в калибровку не идёт
+    for (int a = 0; a < 3; ++a) {
+      if (block_.Variance(a) >
+          kStationaryGyroDeviation * kStationaryGyroDeviation) {
+        block_moved_ = true;
+      }
+    }
+    if (block_moved_) {
+      ++rejected_blocks_;
+    } else {
+      total_.Merge(block_);
+    }
+    block_ = Statistics();
+    block_moved_ = false;
+  }
 }
@@ -7,30 +7,59 @@
 #include "vr_helmet.h"
 #include "vr_helmet_hid.h"
 
-/*! Класс для проведения калибровки сенсоров шлема */
+/*! Класс для проведения калибровки сенсоров шлема. Среднее и дисперсия
+скоростей считаются по ходу калибровки (алгоритм Уэлфорда). Измерения берутся
+блоками, блоки с движением шлема отбрасываются */
 class PsvrHelmetCalibration: public IHelmet, PsvrHelmetHid {
  public:
   PsvrHelmetCalibration();
+  virtual ~PsvrHelmetCalibration();
 
   /*! Возвращает признак, что есть данные от шлема (калибровка идёт).
   Проверку делать не ранее, чем через 2 секунды со старта калибровки */
   bool IsDataAvailable();
 
+  /*! Возвращает признак, что оценка дрейфа достаточно точная и калибровку
+  можно завершать */
+  bool IsConverged();
+
   /*! Завершить калибровку. Вернуть признак успешности */
   bool DoneCalibration();
 
  protected:
-  virtual void OnSensorsData(double to_right, double to_top,
-      double to_clockwork, uint64_t mcs_time) override;
+  virtual void OnSensorsBatch(
+      const SensorsSample* samples, size_t count) override;
 
  private:
-  const int64_t kFixedPointFactor = 1000000000L;
-  const int64_t kMinDataCount = 100;
+  /*! Накопленные среднее и сумма квадратов отклонений по трём осям */
+  struct Statistics {
+    int64_t count;
+    double mean[3];
+    double m2[3];  //!< Сумма квадратов отклонений от среднего
+
+    /*! Добавить измерение */
+    void Add(const double* values);
+    /*! Объединить с другой статистикой */
+    void Merge(const Statistics& other);
+    /*! Дисперсия по оси */
+    double Variance(int axis) const;
+  };
+
+  const int64_t kMinDataCount = 2000;  //!< Минимум измерений для калибровки
+  const int64_t kBlockSize =
+      200;  //!< Размер блока для проверки неподвижности (~0.1 с)
+  const double kStationaryGyroDeviation =
+      0.0005;  //!< Допустимое СКО скорости в блоке, градусы в миллисекунду
+  const double kAccelTolerance =
+      0.1;  //!< Допустимое отклонение модуля ускорения от 1 g
+  const double kBiasPrecision =
+      0.000002;  //!< Требуемая точность оценки дрейфа, градусы в миллисекунду
 
-  int64_t to_right_summ_;
-  int64_t to_top_summ_;
-  int64_t to_clockwork_summ_;
-  int64_t data_counter_;
+  Statistics total_;  //!< Статистика принятых блоков
+  Statistics block_;  //!< Статистика текущего блока
+  bool block_moved_;  //!< Признак движения шлема в текущем блоке
+  int64_t data_counter_;  //!< Количество всех полученных измерений
+  int64_t rejected_blocks_;  //!< Количество отброшенных блоков
   std::mutex data_lock_;
 
   // Путь к файлу с конфигурационными данными
@@ -40,7 +69,10 @@ class PsvrHelmetCalibration: public IHelmet, PsvrHelmetHid {
   void SetVRMode(VRMode) override{};
   void CenterView() override{};
   void GetViewPoint(glm::mat4&) override{};
+  void GetViewPointAt(
+      std::chrono::steady_clock::time_point, glm::mat4&) override{};
   void SetRotationSpeedup(double) override{};
+  void SetWornFn(std::function<void(bool)>) override{};
 };
 
 #endif  // PSVRHELMETCALIBRATION_H
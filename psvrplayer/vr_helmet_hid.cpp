@@ -1,5 +1,6 @@
 #include "vr_helmet_hid.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <iostream>
@@ -10,17 +11,72 @@
 #include <libusb.h>
 
 #include "config_file.h"
+#include "metrics.h"
+#include "thread_policy.h"
+#include "trace.h"
 
 // Хак для обработки хидеров: товарисчи везде пихают свою реализацию min
 #undef min
 
+// Формат записи сенсоров: заголовок kRecordMagic, затем записи из времени
+// прихода пакета (8 байт, мкс), размера пакета (2 байта) и самого пакета.
+// Числа записываются в порядке little-endian
+const char kRecordMagic[8] = {'P', 'S', 'V', 'R', 'S', 'N', 'S', '1'};
+
+std::string PsvrHelmetHid::record_fname_;
+std::string PsvrHelmetHid::replay_fname_;
+int PsvrHelmetHid::replay_speed_ = 1;
+
+
+int64_t SteadyMicroseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 PsvrHelmetHid::PsvrHelmetHid()
     : control_(uint32_t(-1)),
       sensors_(uint32_t(-1)),
       usb_context_(nullptr),
-      usb_device_(nullptr) {
+      usb_device_(nullptr),
+      wakeup_latency_(Metrics::GetHistogram("sensors_wakeup_us")),
+      active_transfers_(0) {
   shutdown_flag_ = false;
   sensor_timer_ = 0;
+  has_device_time_ = false;
+  last_device_time_ = 0;
+  clock_offset_ = 0;
+  replay_start_ = 0;
+  sensors_latency_ = 0;
+  worn_state_ = WornState::kUnknown;
+  removed_since_ = -1;
+
+  if (!replay_fname_.empty()) {
+    replay_file_.open(replay_fname_, std::ios_base::in | std::ios_base::binary);
+    char magic[sizeof(kRecordMagic)];
+    if (!replay_file_.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), kRecordMagic)) {
+      std::cerr << "Can't open sensors record '" << replay_fname_ << "'"
+                << std::endl;
+      throw std::runtime_error("Can't open sensors record");
+    }
+
+    std::thread t([this]() { ReplayHid(); });
+    std::swap(read_thread_, t);
+    assert(!t.joinable());
+    return;
+  }
+
+  if (!record_fname_.empty()) {
+    record_file_.open(record_fname_,
+        std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (record_file_) {
+      record_file_.write(kRecordMagic, sizeof(kRecordMagic));
+    } else {
+      std::cerr << "Can't create sensors record '" << record_fname_
+                << "'. Recording is disabled" << std::endl;
+    }
+  }
 
   auto ur = libusb_init_context(&usb_context_, nullptr, 0);
   if (ur != 0) {
@@ -43,15 +99,27 @@ PsvrHelmetHid::PsvrHelmetHid()
 
 
 PsvrHelmetHid::~PsvrHelmetHid() {
+  StopReading();
+  telemetry_.Report();
+
+  CloseDevice();
+
+  if (usb_context_) {
+    libusb_exit(usb_context_);
+    usb_context_ = nullptr;
+  }
+}
+
+
+void PsvrHelmetHid::StopReading() {
   shutdown_flag_.store(true, std::memory_order_release);
+  // Будим поток чтения, ожидающий событий libusb
+  if (usb_context_) {
+    libusb_interrupt_event_handler(usb_context_);
+  }
   if (read_thread_.joinable()) {
     read_thread_.join();
   }
-
-  CloseDevice();
-
-  libusb_exit(usb_context_);
-  usb_context_ = nullptr;
 }
 
 
@@ -152,8 +220,16 @@ void PsvrHelmetHid::CloseDevice() {
 }
 
 
+struct PsvrHelmetHid::TransferDispatcher {
+  static void LIBUSB_CALL OnTransfer(libusb_transfer* transfer) {
+    static_cast<PsvrHelmetHid*>(transfer->user_data)->OnTransferDone(transfer);
+  }
+};
+
+
 void PsvrHelmetHid::ReadHid() {
   assert(usb_device_);
+  SetupThread("sensors");
 
   PointDescription snr;
   snr.Deserialize(sensors_.load());
@@ -164,92 +240,289 @@ void PsvrHelmetHid::ReadHid() {
     return;
   }
 
-  // TODO Использовать аппаратные часы таймера вместо компьютерных
-  std::chrono::steady_clock::time_point prev_reading =
-      std::chrono::steady_clock::now();
-
-  while (true) {
-    if (shutdown_flag_.load(std::memory_order_acquire)) {
+  // Запускаем сразу несколько запросов: пока обрабатывается один пакет,
+  // следующие уже ожидают данных от устройства
+  active_transfers_ = 0;
+  for (int i = 0; i < kTransfersAmount; ++i) {
+    libusb_transfer* transfer = libusb_alloc_transfer(0);
+    if (!transfer) {
+      std::wcerr << "Can't allocate usb transfer" << std::endl;
       break;
     }
-
-    const int kPacketSize = 64;
-    const int kMaxBufferSize = 70;
-    unsigned char buffer[kMaxBufferSize];
-    int transf;
-    int res = libusb_interrupt_transfer(usb_device_, snr.Endpoint, buffer,
-        kMaxBufferSize, &transf, kReadTimeout);
-    auto ct = std::chrono::steady_clock::now();
-
-    if (res != 0) {
-      // Ошибка чтения устройства
-      if (res == LIBUSB_ERROR_TIMEOUT) {
-        // Недождались. Подождём ещё
-        continue;
-      }
-      
-      // Остальное, похоже, не лечится
-      std::wcerr << "Error of device sensors reading: " << libusb_strerror(res)
+    transfers_.push_back(transfer);
+    libusb_fill_interrupt_transfer(transfer, usb_device_, snr.Endpoint,
+        new unsigned char[kMaxBufferSize], kMaxBufferSize,
+        TransferDispatcher::OnTransfer, this, kReadTimeout);
+    err = libusb_submit_transfer(transfer);
+    if (err != 0) {
+      std::wcerr << "Error of device sensors reading: " << libusb_strerror(err)
                  << std::endl;
       break;
     }
+    ++active_transfers_;
+  }
 
-    if ((transf != kPacketSize) && (transf != kPacketSize + 1)) {
-      // Пришли данные неожиданного размера
-      // Прим.: может передаваться завершающий 0 вне запрашиваемого пакета
-      continue;
+  bool cancelled = false;
+  while (active_transfers_ > 0) {
+    if (!cancelled && shutdown_flag_.load(std::memory_order_acquire)) {
+      // Отменённые запросы ещё завершатся через обработку событий
+      for (auto transfer : transfers_) {
+        libusb_cancel_transfer(transfer);
+      }
+      cancelled = true;
     }
+    err = libusb_handle_events_completed(usb_context_, nullptr);
+    if (err != 0 && err != LIBUSB_ERROR_INTERRUPTED) {
+      std::wcerr << "Error of usb events handling: " << libusb_strerror(err)
+                 << std::endl;
+      break;
+    }
+  }
 
-    int16_t right_acc = read_int16(buffer, 20) + read_int16(buffer, 36);
-    int16_t top_acc = read_int16(buffer, 22) + read_int16(buffer, 38);
-    int16_t roll_acc = read_int16(buffer, 24) + read_int16(buffer, 40);
-
-    static int32_t last_st = std::numeric_limits<int32_t>::min();
-    auto st = read_int32(buffer, 16);
-    if (last_st == std::numeric_limits<int32_t>::min()) {
-      last_st = st;
+  if (active_transfers_ == 0) {
+    for (auto transfer : transfers_) {
+      delete[] transfer->buffer;
+      libusb_free_transfer(transfer);
     }
-    auto dst = st - last_st;  // TODO Use hardware timer for calculation
-    last_st = st;
+  } else {
+    // Запросы ещё у libusb, освобождать их нельзя
+    std::wcerr << "Usb transfers are leaked on sensors reading stop"
+               << std::endl;
+  }
+  transfers_.clear();
 
-    int64_t ims =
-        std::chrono::duration_cast<std::chrono::microseconds>(ct - prev_reading)
-            .count();
-    prev_reading = ct;
-    sensor_timer_ += ims;
+  err = libusb_release_interface(usb_device_, snr.Interface);
+  if (err != 0) {
+    std::wcerr << "Error of device sensors releasing: " << libusb_strerror(err)
+               << std::endl;
+    return;
+  }
+}
 
-    double right_da = -(right_acc * kAccelerationScale);
-    double top_da = (top_acc * kAccelerationScale);
-    double roll_da = -(roll_acc * kAccelerationScale);
 
-    OnSensorsData(right_da, top_da, roll_da, sensor_timer_);
+void PsvrHelmetHid::OnTransferDone(libusb_transfer* transfer) {
+  TRACE_SCOPE("SensorsTransfer");
+  switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED: {
+      auto host_time = SteadyMicroseconds();
+      if (record_file_.is_open()) {
+        RecordPacket(transfer->buffer, transfer->actual_length, host_time);
+      }
+      ProcessPacket(transfer->buffer, transfer->actual_length, host_time);
+    } break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+      telemetry_.OnTimeout();
+      break;
+    case LIBUSB_TRANSFER_CANCELLED:
+      --active_transfers_;
+      return;
+    default:
+      // Остальное, похоже, не лечится
+      std::wcerr << "Error of device sensors reading, status "
+                 << transfer->status << std::endl;
+      telemetry_.OnError();
+      --active_transfers_;
+      return;
   }
 
-  err = libusb_release_interface(usb_device_, snr.Interface);
+  if (shutdown_flag_.load(std::memory_order_acquire)) {
+    --active_transfers_;
+    return;
+  }
+  int err = libusb_submit_transfer(transfer);
   if (err != 0) {
-    std::wcerr << "Error of device sensors releasing: " << libusb_strerror(err)
+    std::wcerr << "Error of device sensors reading: " << libusb_strerror(err)
                << std::endl;
+    --active_transfers_;
+  }
+}
+
+
+void PsvrHelmetHid::ProcessPacket(
+    const unsigned char* buffer, int length, int64_t host_time) {
+  if (!SensorsPacket::IsValidSize(length)) {
+    // Пришли данные неожиданного размера
+    telemetry_.OnMalformed();
     return;
   }
+
+  // В пакете два последовательных измерения со своими метками времени
+  const int kSamples = SensorsPacket::kSamplesPerPacket;
+  SensorsSample samples[kSamples];
+  for (int i = 0; i < kSamples; ++i) {
+    SensorsSample& sample = samples[i];
+    sample.mcs_time = UpdateSensorTimer(
+        SensorsPacket::GetDeviceTime(buffer, i), host_time);
+    sample.host_time = ToViewTime(int64_t(sample.mcs_time) + clock_offset_);
+    SensorsPacket::DecodeSample(buffer, i, sample);
+  }
+
+  telemetry_.OnPacket(host_time, samples[0].mcs_time);
+  TRACE_COUNTER("SensorsLatencyUs", double(GetSensorsLatency()));
+  OnSensorsBatch(samples, kSamples);
+  UpdateWornState(SensorsPacket::IsWorn(buffer), host_time);
 }
 
 
-int16_t PsvrHelmetHid::read_int16(const unsigned char* buffer, int offset) {
-  int16_t v;
-  v = buffer[offset];
-  v |= buffer[offset + 1] << 8;
-  return v;
+uint64_t PsvrHelmetHid::UpdateSensorTimer(
+    uint32_t device_time, int64_t host_time) {
+  // Время измерения берём по часам шлема: 32-битный счётчик микросекунд.
+  // Беззнаковая разность корректно проходит через переполнение счётчика
+  if (has_device_time_) {
+    int64_t dst = uint32_t(device_time - last_device_time_);
+    if (dst > kMaxSensorInterval) {
+      // Часы шлема сбросились или пакет испорчен: считаем по часам компьютера
+      dst = std::max<int64_t>(
+          0, host_time - clock_offset_ - int64_t(sensor_timer_));
+      dst = std::min(dst, kMaxSensorInterval);
+      clock_offset_ = host_time - int64_t(sensor_timer_ + dst);
+      telemetry_.OnClockReset();
+    } else {
+      telemetry_.OnSampleInterval(dst);
+    }
+    sensor_timer_ += dst;
+  }
+  last_device_time_ = device_time;
+
+  // Смещение часов оцениваем по нижней границе (пакет не может прийти раньше
+  // измерения), медленно подстраиваясь вверх на случай дрейфа часов
+  int64_t offset = host_time - int64_t(sensor_timer_);
+  if (!has_device_time_ || offset < clock_offset_) {
+    clock_offset_ = offset;
+  } else {
+    clock_offset_ += (offset - clock_offset_) / kOffsetDriftFactor;
+  }
+  has_device_time_ = true;
+  // Задержка сверх наименьшей включает и передачу по usb, и ожидание потока.
+  // При воспроизведении время прихода пакетов расчётное и не учитывается
+  sensors_latency_.store(offset - clock_offset_, std::memory_order_relaxed);
+  if (!replay_file_.is_open()) {
+    wakeup_latency_.Add(offset - clock_offset_);
+  }
+  return sensor_timer_;
 }
 
 
-int32_t PsvrHelmetHid::read_int32(const unsigned char* buffer, int offset) {
-  return (buffer[offset + 0] << 0) | (buffer[offset + 1] << 8) |
-         (buffer[offset + 2] << 16) | (buffer[offset + 3] << 24);
+void PsvrHelmetHid::UpdateWornState(bool worn, int64_t host_time) {
+  if (worn) {
+    removed_since_ = -1;
+    if (worn_state_ != WornState::kWorn) {
+      worn_state_ = WornState::kWorn;
+      OnWornChanged(true);
+    }
+    return;
+  }
+
+  // Датчик может кратковременно терять голову, поэтому снятие сообщаем
+  // только после задержки
+  if (removed_since_ < 0) {
+    removed_since_ = host_time;
+  }
+  if (worn_state_ != WornState::kRemoved &&
+      host_time - removed_since_ >= kRemovalDelay) {
+    worn_state_ = WornState::kRemoved;
+    OnWornChanged(false);
+  }
+}
+
+
+void PsvrHelmetHid::SetSensorsRecording(const std::string& fname) {
+  record_fname_ = fname;
+}
+
+
+void PsvrHelmetHid::SetSensorsReplay(const std::string& fname, int speed) {
+  replay_fname_ = fname;
+  replay_speed_ = speed;
+}
+
+
+void PsvrHelmetHid::RecordPacket(
+    const unsigned char* buffer, int length, int64_t host_time) {
+  unsigned char header[10];
+  for (int i = 0; i < 8; ++i) {
+    header[i] = (uint64_t(host_time) >> (i * 8)) & 0xff;
+  }
+  header[8] = length & 0xff;
+  header[9] = (length >> 8) & 0xff;
+  record_file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  record_file_.write(reinterpret_cast<const char*>(buffer), length);
+}
+
+
+void PsvrHelmetHid::ReplayHid() {
+  const int kMaxRecordSize = 0xffff;
+  std::vector<unsigned char> buffer(kMaxRecordSize);
+  bool has_start = false;
+  int64_t record_start = 0;  // Время первого пакета записи
+  auto start_time = std::chrono::steady_clock::now();
+  SetupThread("sensors");
+  if (replay_speed_ == 0) {
+    std::cerr << "Sensors replay without pauses: the view does not follow "
+                 "the recording in time"
+              << std::endl;
+  }
+
+  while (!shutdown_flag_.load(std::memory_order_acquire)) {
+    unsigned char header[10];
+    if (!replay_file_.read(reinterpret_cast<char*>(header), sizeof(header))) {
+      break;
+    }
+    uint64_t record_time = 0;
+    for (int i = 0; i < 8; ++i) {
+      record_time |= uint64_t(header[i]) << (i * 8);
+    }
+    int length = header[8] | (header[9] << 8);
+    if (!replay_file_.read(reinterpret_cast<char*>(buffer.data()), length)) {
+      break;
+    }
+
+    if (!has_start) {
+      has_start = true;
+      record_start = int64_t(record_time);
+      replay_start_ = SteadyMicroseconds();
+    }
+    // Время пакетов - записанное, сдвинутое на начало воспроизведения. Так
+    // обработка детерминирована при любой скорости воспроизведения. Для
+    // отрисовки время измерений переводится в ускоренное (см. ToViewTime)
+    int64_t offset = int64_t(record_time) - record_start;
+    if (replay_speed_ > 0) {
+      auto wakeup =
+          start_time + std::chrono::microseconds(offset / replay_speed_);
+      std::this_thread::sleep_until(wakeup);
+      wakeup_latency_.Add(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - wakeup)
+              .count());
+    }
+    ProcessPacket(buffer.data(), length, replay_start_ + offset);
+  }
+
+  if (!shutdown_flag_.load(std::memory_order_acquire)) {
+    std::cerr << "Sensors replay is finished" << std::endl;
+  }
+}
+
+
+int64_t PsvrHelmetHid::ToViewTime(int64_t host_time) const {
+  if (!replay_file_.is_open() || replay_speed_ <= 1) {
+    return host_time;
+  }
+  return replay_start_ + (host_time - replay_start_) / replay_speed_;
+}
+
+
+int64_t PsvrHelmetHid::GetSensorsLatency() const {
+  return sensors_latency_.load(std::memory_order_relaxed);
 }
 
 
 bool PsvrHelmetHid::SplitScreen(bool split_mode) {
   bool r = true;
+  if (!replay_fname_.empty()) {
+    // При воспроизведении записи устройства нет
+    return true;
+  }
   assert(usb_device_);
 
   PointDescription cnt;
@@ -2,13 +2,20 @@
 #define PSVRHELMETHID_H
 
 #include <atomic>
+#include <cstdint>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "latency_histogram.h"
+#include "sensor_telemetry.h"
+#include "sensors_packet.h"
+
 class libusb_context;
 class libusb_device_handle;
+struct libusb_transfer;
 
 /*!
  * @brief Описание интерфейса-конечной точки для работы со шлемом
@@ -56,30 +63,69 @@ class PsvrHelmetHid {
   \return список точек для подключения с именами. Если список пустой, то устройства нет или занято */
   static std::vector<PointDescription> GetDevicesName();
 
+  /*! Задать файл для записи сырых пакетов сенсоров (с временем прихода).
+  Вызывается до создания шлема
+  \param fname имя файла. Пустое имя - запись выключена */
+  static void SetSensorsRecording(const std::string& fname);
+
+  /*! Задать файл записи сенсоров для воспроизведения вместо устройства.
+  Вызывается до создания шлема
+  \param fname имя файла. Пустое имя - работа с устройством
+  \param speed ускорение воспроизведения, в разах. 0 - без пауз */
+  static void SetSensorsReplay(const std::string& fname, int speed);
+
  protected:
-  /*! Функция для обработки данных скорости поворота от сенсоров. Скорость
-  измеряется в градусах в миллисекунду. Функция вызывается в отдельном потоке.
+  /*! Функция для обработки пачки измерений сенсоров из одного пакета.
+  Измерения упорядочены по времени. Функция вызывается в отдельном потоке.
   Функция не должна задерживать выполнение потока (обычный интервал прихода
-  следующих данных - 1 мс) \param to_right_accel скорость поворота вправо \param
-  to_top_accel скорость поворота вверх \param to_clockwork_accel скорость
-  поворота по часовой стрелке
-  \param mcs_time глобальный счётчик времени (всегда увеличивается) */
-  virtual void OnSensorsData(
-      double to_right, double to_top, double to_clockwork, uint64_t mcs_time){};
+  следующих данных - 1 мс)
+  \param samples измерения
+  \param count количество измерений */
+  virtual void OnSensorsBatch(const SensorsSample* samples, size_t count){};
+
+  /*! Функция для обработки смены состояния шлема: надет или снят (по датчику
+  приближения). Снятие сообщается после kRemovalDelay без датчика, надевание -
+  сразу. Функция вызывается в потоке чтения и, как OnSensorsBatch, не должна
+  его задерживать
+  \param worn признак, что шлем надет */
+  virtual void OnWornChanged(bool worn){};
 
   bool SplitScreen(bool split_mode);
 
+  /*! Остановить поток чтения сенсоров и дождаться его завершения. После
+  возврата OnSensorsBatch и OnWornChanged больше не вызываются. Наследник
+  вызывает функцию первой в своём деструкторе: деструктор этого класса
+  выполняется уже после уничтожения полей наследника. Повторный вызов ничего
+  не делает */
+  void StopReading();
+
+  /*! Выдать оценку задержки доставки данных сенсоров до компьютера: время от
+  измерения до обработки пакета сверх минимального наблюдаемого. Используется
+  только для метрик
+  \return задержка в микросекундах */
+  int64_t GetSensorsLatency() const;
+
  private:
   PsvrHelmetHid(const PsvrHelmetHid&) = delete;
   PsvrHelmetHid(PsvrHelmetHid&&) = delete;
   PsvrHelmetHid& operator=(const PsvrHelmetHid&) = delete;
   PsvrHelmetHid& operator=(PsvrHelmetHid&&) = delete;
 
-  static const int kReadTimeout =
-      10;  //!< Таймаут на чтение данных из hid-устройства
+  static const int kTransfersAmount =
+      8;  //!< Количество одновременно ожидающих запросов чтения сенсоров
+  static const int kMaxBufferSize = 70;  //!< Размер буфера одного запроса
   static const int kWriteTimeout =
       1000;  //!< Таймаут на запись данных в hid-устройство
-  const double kAccelerationScale = 0.00003125;
+  static const unsigned int kReadTimeout =
+      100;  //!< Таймаут запроса чтения сенсоров, мс. Запрос без данных за это
+            //!< время учитывается как таймаут и отправляется снова
+  const int64_t kRemovalDelay =
+      1000000;  //!< Сколько датчик должен не видеть голову до снятия, мкс
+  const int64_t kMaxSensorInterval =
+      100000;  //!< Максимальный интервал между пакетами по часам шлема, мкс.
+               //!< Больший скачок считается сбросом часов
+  const int64_t kOffsetDriftFactor =
+      1024;  //!< Инерционность подстройки смещения часов в сторону увеличения
 
   static const unsigned short kPsvrVendorID = 0x054c;
   static const unsigned short kPsvrProductID = 0x09af;
@@ -91,25 +137,95 @@ class PsvrHelmetHid {
       control_;  //!< Opened control device with hid_device* type. Or nullptr
   std::atomic<uint32_t> sensors_;  //!< Устройство-сенсоры шлема
   uint64_t sensor_timer_;  //!< Часы таймера. Монотонно растут, отсчитывают
-                           //!< микросекунды
+                           //!< микросекунды по часам шлема
+  bool has_device_time_;  //!< Признак, что метка времени шлема уже получена
+  uint32_t last_device_time_;  //!< Последняя метка времени шлема, мкс
+  int64_t clock_offset_;  //!< Оценка смещения часов компьютера относительно
+                          //!< часов шлема, мкс
+  std::atomic<int64_t> sensors_latency_;  //!< Задержка доставки данных, мкс
+  LatencyHistogram& wakeup_latency_;  //!< Задержки пробуждения потока чтения
+
+  /*! Состояние шлема по датчику приближения */
+  enum class WornState { kUnknown, kWorn, kRemoved };
+
+  WornState worn_state_;  //!< Сообщённое состояние. Используется потоком
+                          //!< чтения
+  int64_t removed_since_;  //!< Время, с которого датчик не видит голову, мкс.
+                           //!< -1 - видит
+  SensorTelemetry telemetry_;  //!< Телеметрия потока чтения
+
+  static std::string record_fname_;  //!< Файл для записи пакетов сенсоров
+  static std::string replay_fname_;  //!< Файл для воспроизведения сенсоров
+  static int replay_speed_;  //!< Ускорение воспроизведения. 0 - без пауз
+  int64_t replay_start_;  //!< Время начала воспроизведения, мкс. Используется
+                          //!< потоком воспроизведения
+  std::ofstream record_file_;  //!< Запись пакетов. Используется потоком чтения
+  std::ifstream replay_file_;  //!< Воспроизводимая запись пакетов
   std::thread read_thread_;  //!< Поток чтения позиции шлема
   std::atomic_bool shutdown_flag_;  //!< Флаг завершения поток чтения
+  std::vector<libusb_transfer*>
+      transfers_;  //!< Запросы чтения сенсоров. Используются потоком чтения
+  int active_transfers_;  //!< Количество запросов в работе. Используется
+                          //!< потоком чтения
+
+  struct TransferDispatcher;  //!< Обработчик завершения запросов libusb
 
 
   bool OpenDevice();
   void CloseDevice();
 
   /*! Функция вычитывания состояния сенсоров. Обычно выполняется в отдельном
-  потоке. Завершается при выставлении флага shutdown_flag_ */
+  потоке. В работе держится несколько асинхронных запросов чтения, которые
+  перезапускаются по завершению, чтобы не терять пакеты между запросами.
+  Завершается при выставлении флага shutdown_flag_ и прерывании ожидания
+  событий libusb */
   void ReadHid();
 
-  /*! Функция вычитывания из буфера 16-битного значения
-  \param buffer буфер с данными
-  \param offset смещение числа
-  \return число из буфера */
-  static int16_t read_int16(const unsigned char* buffer, int offset);
-
-  static int32_t read_int32(const unsigned char* buffer, int offset);
+  /*! Обработать завершение запроса чтения сенсоров и перезапустить его.
+  Вызывается в потоке чтения
+  \param transfer завершённый запрос */
+  void OnTransferDone(libusb_transfer* transfer);
+
+  /*! Разобрать пакет с данными сенсоров
+  \param buffer данные пакета
+  \param length размер данных
+  \param host_time время прихода пакета по часам компьютера, мкс */
+  void ProcessPacket(
+      const unsigned char* buffer, int length, int64_t host_time);
+
+  /*! Перевести время измерения во время его показа. При воспроизведении
+  записи пакеты получают записанное время, чтобы обработка не зависела от
+  скорости, но приходят в ускоренном темпе. Положение же запрашивается на время
+  показа кадра, поэтому время измерений переводится в темп воспроизведения.
+  Без пауз (скорость 0) время не переводится: отрисовка такого воспроизведения
+  не следует записи
+  \param host_time время по часам компьютера, мкс
+  \return время для запросов положения по часам steady_clock, мкс */
+  int64_t ToViewTime(int64_t host_time) const;
+
+  /*! Функция воспроизведения записи сенсоров вместо чтения устройства.
+  Выполняется в отдельном потоке. Завершается при выставлении флага
+  shutdown_flag_ или в конце записи */
+  void ReplayHid();
+
+  /*! Записать пакет сенсоров в файл записи
+  \param buffer данные пакета
+  \param length размер данных
+  \param host_time время прихода пакета, мкс */
+  void RecordPacket(const unsigned char* buffer, int length, int64_t host_time);
+
+  /*! Продвинуть часы таймера по метке времени шлема и обновить оценку
+  смещения часов компьютера
+  \param device_time метка времени шлема из пакета, мкс
+  \param host_time время обработки пакета по часам компьютера, мкс
+  \return время измерения по часам таймера */
+  uint64_t UpdateSensorTimer(uint32_t device_time, int64_t host_time);
+
+  /*! Обновить состояние шлема по датчику приближения и сообщить о смене
+  состояния через OnWornChanged
+  \param worn признак из пакета, что датчик видит голову
+  \param host_time время прихода пакета, мкс */
+  void UpdateWornState(bool worn, int64_t host_time);
 };
 
 #endif  // PSVRHELMETHID_H
@@ -1,6 +1,8 @@
 #include "vr_helmet_view.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <mutex>
 #include <stdexcept>
@@ -17,60 +19,63 @@
 
 #include <hidapi.h>
 
+#include "config_file.h"
+#include "metrics.h"
+#include "thread_policy.h"
 #include "iniparser.h"
 #include "home-dir.h"
 
 const char kConfigFileName[] = "/psvrplayer.cfg";
 
-PsvrHelmetView::PsvrHelmetView() {
-  center_view_flag_ = true;
-  last_sensor_time_ = std::numeric_limits<uint64_t>::max();
-
+PsvrHelmetView::PsvrHelmetView()
+    : pose_age_(Metrics::GetHistogram("pose_age_us")) {
   auto cfg = HomeDirLibrary::GetDataDir() + kConfigFileName;
-  std::unique_lock<std::mutex> vl(velo_lock_);
   auto dict = iniparser_load(cfg.c_str());
   if (dict) {
-    right_velo_ = double(iniparser_getint64(dict, "Calibration:right", 0)) /
-                  kFixedPointFactor;
-    top_velo_ = double(iniparser_getint64(dict, "Calibration:top", 0)) /
-                kFixedPointFactor;
-    clock_velo_ = double(iniparser_getint64(dict, "Calibration:clock", 0)) /
-                  kFixedPointFactor;
+    double right = double(iniparser_getint64(dict, "Calibration:right", 0)) /
+                   kFixedPointFactor;
+    double top = double(iniparser_getint64(dict, "Calibration:top", 0)) /
+                 kFixedPointFactor;
+    double clock = double(iniparser_getint64(dict, "Calibration:clock", 0)) /
+                   kFixedPointFactor;
+    fusion_.SetBias(right, top, clock);
     iniparser_freedict(dict);
-  } else {
-    right_velo_ = 0.0;
-    top_velo_ = 0.0;
-    clock_velo_ = 0.0;
   }
-  vl.unlock();
+
+  Config::GetFusionOptions(nullptr, nullptr, nullptr, &save_bias_);
+  worn_ = -1;
+  worn_shutdown_ = false;
+  std::thread t([this]() { NotifyWorn(); });
+  std::swap(worn_thread_, t);
+  assert(!t.joinable());
 }
 
 
-void PsvrHelmetView::OnSensorsData(
-    double to_right, double to_top, double to_clockwork, uint64_t mcs_time) {
-  if (last_sensor_time_ == std::numeric_limits<uint64_t>::max()) {
-    last_sensor_time_ = mcs_time;
-    return;
-  }
-  double ims = (mcs_time - last_sensor_time_) * 0.001;
-  last_sensor_time_ = mcs_time;
-
-  std::unique_lock<std::mutex> vl(velo_lock_);
-  double right_da = (to_right - right_velo_) * ims;
-  double top_da = (to_top - top_velo_) * ims;
-  double roll_da = (to_clockwork - clock_velo_) * ims;
-  vl.unlock();
-
-  bool cv = center_view_flag_.exchange(false);
-  if (cv) {
-    rotation_.Reset();
-  } else {
-    rotation_.Rotate(right_da, top_da, roll_da);
-  }
+void PsvrHelmetView::OnSensorsBatch(
+    const SensorsSample* samples, size_t count) {
+  fusion_.ProcessBatch(samples, count);
 }
 
 
-PsvrHelmetView::~PsvrHelmetView() {}
+PsvrHelmetView::~PsvrHelmetView() {
+  // Поток сенсоров использует поля этого класса, поэтому останавливается до
+  // их уничтожения. Заодно последнее измерение не изменит сохраняемый дрейф
+  StopReading();
+
+  std::unique_lock<std::mutex> lk(worn_lock_);
+  worn_shutdown_ = true;
+  lk.unlock();
+  worn_var_.notify_one();
+  if (worn_thread_.joinable()) {
+    worn_thread_.join();
+  }
+
+  double right, top, clock;
+  bool save = fusion_.GetBias(&right, &top, &clock) && save_bias_;
+  if (save && !Config::SetCalibration(right, top, clock, 0, nullptr)) {
+    std::cerr << "Can't save refined gyro bias" << std::endl;
+  }
+}
 
 
 void PsvrHelmetView::SetVRMode(IHelmet::VRMode mode) {
@@ -78,17 +83,77 @@ void PsvrHelmetView::SetVRMode(IHelmet::VRMode mode) {
 }
 
 
-void PsvrHelmetView::CenterView() { center_view_flag_ = true; }
+void PsvrHelmetView::CenterView() { fusion_.CenterView(); }
 
 void PsvrHelmetView::GetViewPoint(glm::mat4& rot_mat) {
-  bool cv = center_view_flag_.exchange(false);
-  if (cv) {
-    rotation_.Reset();
-  }
+  fusion_.GetViewPoint(rot_mat);
+  UpdatePoseAge();
+}
 
-  rotation_.GetSummRotation(rot_mat);
+void PsvrHelmetView::GetViewPointAt(
+    std::chrono::steady_clock::time_point time, glm::mat4& rot_mat) {
+  int64_t mcs = std::chrono::duration_cast<std::chrono::microseconds>(
+      time.time_since_epoch())
+                    .count();
+  fusion_.GetViewPointAt(mcs, rot_mat);
+  UpdatePoseAge();
+}
+
+void PsvrHelmetView::UpdatePoseAge() {
+  int64_t last = fusion_.GetLastPoseTime();
+  if (last == 0) {
+    return;
+  }
+  int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  pose_age_.Add(now - last);
 }
 
 void PsvrHelmetView::SetRotationSpeedup(double speedup) {
-  rotation_.SetRotationSpeedup(speedup);
+  fusion_.SetRotationSpeedup(speedup);
+}
+
+void PsvrHelmetView::SetWornFn(std::function<void(bool worn)> fn) {
+  // Блокировка функции дожидается завершения идущего оповещения, поэтому
+  // после смены функции прежняя уже не вызывается
+  std::lock_guard<std::mutex> fl(worn_fn_lock_);
+  on_worn_ = fn;
+  std::unique_lock<std::mutex> lk(worn_lock_);
+  int worn = worn_;
+  lk.unlock();
+  if (on_worn_ && worn >= 0) {
+    on_worn_(worn != 0);
+  }
+}
+
+void PsvrHelmetView::OnWornChanged(bool worn) {
+  // Поток сенсоров только запоминает состояние, оповещает отдельный поток
+  std::unique_lock<std::mutex> lk(worn_lock_);
+  worn_ = worn ? 1 : 0;
+  lk.unlock();
+  worn_var_.notify_one();
+}
+
+void PsvrHelmetView::NotifyWorn() {
+  SetupThread("worn");
+  int notified = -1;
+  std::unique_lock<std::mutex> lk(worn_lock_);
+  while (true) {
+    worn_var_.wait(
+        lk, [this, notified] { return worn_shutdown_ || worn_ != notified; });
+    if (worn_shutdown_) {
+      break;
+    }
+    // Частые смены состояния схлопываются: оповещаем о последнем
+    notified = worn_;
+    lk.unlock();
+    {
+      std::lock_guard<std::mutex> fl(worn_fn_lock_);
+      if (on_worn_) {
+        on_worn_(notified != 0);
+      }
+    }
+    lk.lock();
+  }
 }
@@ -2,6 +2,8 @@
 #define PSVRHELMETVIEW_H
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <thread>
 
@@ -14,7 +16,8 @@
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/vector_angle.hpp>
 
-#include "rotation.h"
+#include "latency_histogram.h"
+#include "sensor_fusion.h"
 #include "vr_helmet.h"
 #include "vr_helmet_hid.h"
 
@@ -29,11 +32,15 @@ class PsvrHelmetView: public IHelmet, protected PsvrHelmetHid {
   void SetVRMode(VRMode mode) override;
   void CenterView() override;
   void GetViewPoint(glm::mat4& rotation) override;
+  void GetViewPointAt(std::chrono::steady_clock::time_point time,
+      glm::mat4& rotation) override;
   void SetRotationSpeedup(double speedup) override;
+  void SetWornFn(std::function<void(bool worn)> fn) override;
 
  protected:
-  virtual void OnSensorsData(double to_right, double to_top,
-      double to_clockwork, uint64_t mcs_time) override;
+  virtual void OnSensorsBatch(
+      const SensorsSample* samples, size_t count) override;
+  virtual void OnWornChanged(bool worn) override;
 
  private:
   PsvrHelmetView(const PsvrHelmetView&) = delete;
@@ -44,18 +51,30 @@ class PsvrHelmetView: public IHelmet, protected PsvrHelmetHid {
 
   const int64_t kFixedPointFactor = 1000000000L;
 
-  using vec3d = glm::vec<3, double, glm::defaultp>;
-
-  std::atomic_bool center_view_flag_;
-  uint64_t last_sensor_time_;
-
-  double right_velo_;  //!< Скорость "дрейфа" шлема вправо (из калибровки)
-  double top_velo_;  //!< Скорость "дрейфа" шлема вверх (из калибровки)
-  double clock_velo_;  //!< Скорость "дрейфа" шлема по часовой стрелке (из
-                       //!< калибровки)
-  std::mutex velo_lock_;
-
-  Rotation rotation_;  //!< Математика для расчёта вращений
+  bool save_bias_;  //!< Сохранять уточнённый дрейф при завершении
+  SensorFusion fusion_;  //!< Расчёт положения по измерениям сенсоров
+
+  std::function<void(bool worn)> on_worn_;  //!< Оповещение о снятии шлема.
+                                           //!< Под блокировкой worn_fn_lock_
+  std::mutex worn_fn_lock_;  //!< Блокировка для on_worn_ и его вызова
+  int worn_;  //!< Последнее состояние: 1 - надет, 0 - снят, -1 - неизвестно.
+              //!< Под блокировкой worn_lock_
+  bool worn_shutdown_;  //!< Флаг завершения потока оповещений. Под
+                        //!< блокировкой worn_lock_
+  std::mutex worn_lock_;  //!< Блокировка для worn_ и worn_shutdown_
+  std::condition_variable worn_var_;  //!< Событие смены состояния
+  std::thread worn_thread_;  //!< Поток оповещений о снятии шлема
+
+  /*! Функция оповещений о смене состояния шлема. Выполняется в отдельном
+  потоке: оповещение может ставить воспроизведение на паузу и не должно
+  задерживать поток сенсоров */
+  void NotifyWorn();
+
+  LatencyHistogram& pose_age_;  //!< Возраст данных сенсоров при запросе
+                                //!< положения
+
+  /*! Учесть возраст данных сенсоров при запросе положения */
+  void UpdatePoseAge();
 };
 
 
@@ -0,0 +1,134 @@
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "../psvrplayer/one_euro_filter.h"
+
+
+const double kSampleTime = 0.0005;  //!< Период измерений шлема, сек
+const double kSuitableError = 1.0e-9;  //!< Допустимая ошибка скорости
+const double kPi = 3.1415926535897932384626433832795;
+
+
+/*! Пропускает через фильтр постоянную скорость
+\param filter фильтр
+\param value скорость по всем осям
+\param samples количество измерений
+\param velocity возвращаемая отфильтрованная скорость */
+void FeedConstant(
+    OneEuroFilter& filter, double value, int samples, double* velocity) {
+  for (int i = 0; i < samples; ++i) {
+    velocity[0] = value;
+    velocity[1] = value;
+    velocity[2] = value;
+    filter.Filter(velocity, kSampleTime);
+  }
+}
+
+
+TEST(Disabled, OneEuroFilter) {
+  OneEuroFilter filter;
+  filter.SetParameters(0.0, 0.01, 1.0);
+  EXPECT_FALSE(filter.IsEnabled());
+
+  double v[3] = {0.0, 0.0, 0.0};
+  filter.Filter(v, kSampleTime);
+  double step[3] = {100.0, -50.0, 7.0};
+  filter.Filter(step, kSampleTime);
+  EXPECT_EQ(step[0], 100.0);
+  EXPECT_EQ(step[1], -50.0);
+  EXPECT_EQ(step[2], 7.0);
+  EXPECT_EQ(filter.GetLatency(), 0.0);
+}
+
+
+TEST(FirstValue, OneEuroFilter) {
+  OneEuroFilter filter;
+  filter.SetParameters(1.0, 0.0, 1.0);
+  EXPECT_TRUE(filter.IsEnabled());
+
+  // Первое значение проходит без изменений, постоянное - тоже
+  double v[3];
+  FeedConstant(filter, 30.0, 1, v);
+  EXPECT_NEAR(v[0], 30.0, kSuitableError);
+  FeedConstant(filter, 30.0, 100, v);
+  EXPECT_NEAR(v[0], 30.0, kSuitableError);
+  EXPECT_NEAR(v[2], 30.0, kSuitableError);
+}
+
+
+TEST(StepResponse, OneEuroFilter) {
+  OneEuroFilter filter;
+  filter.SetParameters(1.0, 0.0, 1.0);
+  double v[3];
+  FeedConstant(filter, 0.0, 10, v);
+
+  // Скачок сглаживается монотонно, без перерегулирования
+  double prev = 0.0;
+  for (int i = 0; i < 2000; ++i) {
+    FeedConstant(filter, 100.0, 1, v);
+    EXPECT_GT(v[0], prev);
+    EXPECT_LT(v[0], 100.0);
+    prev = v[0];
+  }
+
+  // Без прироста частота среза постоянная: экспоненциальное сглаживание с
+  // постоянной времени 1 / (2 * pi * fc)
+  double tau = 1.0 / (2.0 * kPi);
+  double alpha = 1.0 / (1.0 + tau / kSampleTime);
+  double expected = 100.0 * (1.0 - std::pow(1.0 - alpha, 2000));
+  EXPECT_NEAR(v[0], expected, 1.0e-6);
+  EXPECT_NEAR(filter.GetLatency(), tau, kSuitableError);
+}
+
+
+TEST(SpeedAdaptation, OneEuroFilter) {
+  OneEuroFilter slow;
+  slow.SetParameters(1.0, 0.0, 1.0);
+  OneEuroFilter fast;
+  fast.SetParameters(1.0, 0.1, 1.0);
+
+  double vs[3];
+  double vf[3];
+  FeedConstant(slow, 0.0, 10, vs);
+  FeedConstant(fast, 0.0, 10, vf);
+  double rest_latency = fast.GetLatency();
+  EXPECT_NEAR(rest_latency, 1.0 / (2.0 * kPi), kSuitableError);
+
+  // На большой скорости частота среза растёт: задержка меньше
+  FeedConstant(slow, 200.0, 2000, vs);
+  FeedConstant(fast, 200.0, 2000, vf);
+  EXPECT_GT(vf[0], vs[0]);
+  EXPECT_LT(vf[0], 200.0);
+  EXPECT_LT(fast.GetLatency(), rest_latency);
+}
+
+
+TEST(Reset, OneEuroFilter) {
+  OneEuroFilter filter;
+  filter.SetParameters(1.0, 0.01, 1.0);
+  double v[3];
+  FeedConstant(filter, 0.0, 100, v);
+  FeedConstant(filter, 50.0, 10, v);
+  EXPECT_LT(v[0], 50.0);
+
+  // После сброса первое значение снова проходит без изменений
+  filter.Reset();
+  FeedConstant(filter, 50.0, 1, v);
+  EXPECT_NEAR(v[0], 50.0, kSuitableError);
+}
+
+
+TEST(ZeroInterval, OneEuroFilter) {
+  OneEuroFilter filter;
+  filter.SetParameters(1.0, 0.01, 1.0);
+  double v[3];
+  FeedConstant(filter, 0.0, 10, v);
+
+  // Измерения без прошедшего времени не меняют состояние
+  double step[3] = {100.0, 100.0, 100.0};
+  filter.Filter(step, 0.0);
+  EXPECT_EQ(step[0], 100.0);
+  FeedConstant(filter, 0.0, 1, v);
+  EXPECT_NEAR(v[0], 0.0, kSuitableError);
+}
@@ -0,0 +1,139 @@
+#include <cmath>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <gtest/gtest.h>
+
+#include "../psvrplayer/pose_history.h"
+
+
+const double kSuitableAngleError = 1.0e-9;  //!< Допустимая ошибка угла, рад
+const int64_t kPoseInterval = 1000;  //!< Интервал между положениями, мкс
+
+
+/*! Положение с поворотом вокруг вертикали (оси y)
+\param time время положения, мкс
+\param yaw угол поворота, рад
+\param yaw_speed угловая скорость вокруг вертикали, рад/с */
+PoseHistory::Pose MakePose(int64_t time, double yaw, double yaw_speed = 0.0) {
+  PoseHistory::Pose pose;
+  pose.time = time;
+  pose.orientation = glm::angleAxis(yaw, glm::dvec3(0.0, 1.0, 0.0));
+  pose.velocity = glm::dvec3(0.0, yaw_speed, 0.0);
+  return pose;
+}
+
+
+/*! Угол между поворотами, рад. Кватернионы q и -q задают один поворот.
+Считается через atan2: acos теряет точность у малых углов */
+double AngleBetween(const glm::dquat& a, const glm::dquat& b) {
+  glm::dquat r = a * glm::conjugate(b);
+  double sine = glm::length(glm::dvec3(r.x, r.y, r.z));
+  return 2.0 * std::atan2(sine, std::abs(r.w));
+}
+
+
+/*! Проверяет, что в истории на заданное время поворот на угол yaw */
+void CheckYaw(const PoseHistory& history, int64_t time, double yaw) {
+  glm::dquat q;
+  ASSERT_TRUE(history.GetPoseAt(time, q));
+  EXPECT_LE(AngleBetween(q, MakePose(0, yaw).orientation), kSuitableAngleError)
+      << "time " << time << ", expected yaw " << yaw;
+}
+
+
+TEST(Empty, PoseHistory) {
+  PoseHistory history;
+  glm::dquat q;
+  EXPECT_FALSE(history.GetPoseAt(0, q));
+  EXPECT_FALSE(history.GetPoseAt(1000000, q));
+}
+
+
+TEST(Interpolation, PoseHistory) {
+  PoseHistory history;
+  history.Add(MakePose(1000, 0.0));
+  history.Add(MakePose(2000, glm::radians(90.0)));
+  history.Add(MakePose(4000, glm::radians(120.0)));
+
+  // Точно на сохранённых положениях
+  CheckYaw(history, 1000, 0.0);
+  CheckYaw(history, 2000, glm::radians(90.0));
+  // Сферическая интерполяция между соседними положениями
+  CheckYaw(history, 1500, glm::radians(45.0));
+  CheckYaw(history, 1250, glm::radians(22.5));
+  CheckYaw(history, 3000, glm::radians(105.0));
+}
+
+
+TEST(BeforeFirst, PoseHistory) {
+  PoseHistory history;
+  history.Add(MakePose(1000, glm::radians(10.0)));
+  history.Add(MakePose(2000, glm::radians(20.0)));
+
+  // До первого положения выдаётся первое
+  CheckYaw(history, 0, glm::radians(10.0));
+  CheckYaw(history, -1000000, glm::radians(10.0));
+}
+
+
+TEST(Extrapolation, PoseHistory) {
+  PoseHistory history;
+  history.Add(MakePose(1000, 0.0, 1.0));
+  history.Add(MakePose(2000, 0.001, 1.0));
+
+  // Поворот с последней скоростью: 1 рад/с
+  CheckYaw(history, 2000 + 20000, 0.001 + 0.02);
+  CheckYaw(history, 2000 + 50000, 0.001 + 0.05);
+  // Не дальше 50 мс
+  CheckYaw(history, 2000 + 200000, 0.001 + 0.05);
+  CheckYaw(history, 2000 + 10000000, 0.001 + 0.05);
+}
+
+
+TEST(ExtrapolationWithoutSpeed, PoseHistory) {
+  PoseHistory history;
+  history.Add(MakePose(1000, glm::radians(30.0)));
+  CheckYaw(history, 1000, glm::radians(30.0));
+  CheckYaw(history, 30000, glm::radians(30.0));
+}
+
+
+TEST(RingOverwrite, PoseHistory) {
+  PoseHistory history;
+  const int kPoses = 3 * PoseHistory::kCapacity + 17;
+  for (int i = 0; i < kPoses; ++i) {
+    history.Add(MakePose(i * kPoseInterval, i * 0.001));
+  }
+
+  // Свежие положения и интерполяция между ними
+  CheckYaw(history, (kPoses - 1) * kPoseInterval, (kPoses - 1) * 0.001);
+  CheckYaw(history, (kPoses - 2) * kPoseInterval + kPoseInterval / 2,
+      (kPoses - 2) * 0.001 + 0.0005);
+
+  // Перезаписанные положения недоступны: выдаётся самое старое из оставшихся.
+  // Самая старая ячейка считается переписываемой и не используется
+  const int oldest = kPoses - int(PoseHistory::kCapacity - 1);
+  CheckYaw(history, 0, oldest * 0.001);
+  CheckYaw(history, (oldest - 10) * kPoseInterval, oldest * 0.001);
+  CheckYaw(history, oldest * kPoseInterval + kPoseInterval / 2,
+      oldest * 0.001 + 0.0005);
+}
+
+
+TEST(Clear, PoseHistory) {
+  PoseHistory history;
+  for (int i = 0; i < 100; ++i) {
+    history.Add(MakePose(i * kPoseInterval, i * 0.01));
+  }
+
+  // После центрирования прежние положения не выдаются
+  history.Clear();
+  glm::dquat q;
+  EXPECT_FALSE(history.GetPoseAt(50 * kPoseInterval, q));
+
+  history.Add(MakePose(100 * kPoseInterval, 0.0));
+  history.Add(MakePose(101 * kPoseInterval, 0.002));
+  CheckYaw(history, 50 * kPoseInterval, 0.0);
+  CheckYaw(history, 100 * kPoseInterval + kPoseInterval / 2, 0.001);
+}
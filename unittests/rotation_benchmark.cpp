@@ -0,0 +1,255 @@
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+
+#include "../psvrplayer/one_euro_filter.h"
+#include "../psvrplayer/rotation.h"
+#include "../psvrplayer/sensor_fusion.h"
+#include "../psvrplayer/sensors_packet.h"
+
+
+namespace {
+
+const int kSampleMcs = 500;  //!< Период измерений шлема, мкс (2 кГц)
+const int kPackets = 1024;  //!< Количество разных пакетов в записи
+
+
+/*! Записать в буфер 16-битное значение, как его передаёт шлем */
+void WriteInt16(unsigned char* buffer, int offset, int16_t v) {
+  buffer[offset] = uint8_t(v & 0xff);
+  buffer[offset + 1] = uint8_t((v >> 8) & 0xff);
+}
+
+
+/*! Записать в буфер 32-битное значение, как его передаёт шлем */
+void WriteInt32(unsigned char* buffer, int offset, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    buffer[offset + i] = uint8_t((v >> (8 * i)) & 0xff);
+  }
+}
+
+
+/*! Сформировать пакет сенсоров с медленным поворотом головы и небольшим
+шумом. Раскладка пакета та же, что разбирает SensorsPacket
+\param n номер пакета
+\return данные пакета */
+std::vector<unsigned char> MakePacket(int64_t n) {
+  std::vector<unsigned char> packet(SensorsPacket::kPacketSize, 0);
+  packet[8] = 0x01;  // Шлем надет
+  for (int i = 0; i < SensorsPacket::kSamplesPerPacket; ++i) {
+    int64_t k = n * SensorsPacket::kSamplesPerPacket + i;
+    double t = double(k) * kSampleMcs * 1.0e-6;
+    int noise = int((k * 7919) % 13) - 6;
+    const int base = 16 + i * 16;
+    WriteInt32(packet.data(), base, uint32_t(k * kSampleMcs));
+    // Гироскоп: 16 единиц на градус в секунду, акселерометр: 16384 на g
+    WriteInt16(packet.data(), base + 4, int16_t(-480.0 * std::sin(t) - noise));
+    WriteInt16(packet.data(), base + 6, int16_t(160.0 * std::cos(t * 0.7)));
+    WriteInt16(packet.data(), base + 8, int16_t(noise));
+    WriteInt16(packet.data(), base + 10, int16_t(16384 + noise * 4));
+    WriteInt16(packet.data(), base + 12, int16_t(164.0 * std::sin(t)));
+    WriteInt16(packet.data(), base + 14, int16_t(328.0 * std::cos(t)));
+  }
+  return packet;
+}
+
+
+/*! Выдать текущее время в микросекундах по часам steady_clock */
+int64_t NowMcs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+
+/*! Поток сенсоров: разбор пакета и расчёт положения тем же кодом, что у
+PsvrHelmetView. Часы измерений ведёт PsvrHelmetHid, здесь метка шлема только
+продолжается при повторе записи */
+struct SensorsPath {
+  std::vector<std::vector<unsigned char>> packets;  //!< Записанные пакеты
+  SensorFusion fusion;
+  int64_t number = 0;
+
+  SensorsPath() {
+    for (int i = 0; i < kPackets; ++i) {
+      packets.push_back(MakePacket(i));
+    }
+  }
+
+  /*! Разобрать следующий пакет
+  \param samples возвращаемые измерения пакета */
+  void Decode(SensorsSample* samples) {
+    const auto& packet = packets[number % kPackets];
+    const uint64_t repeat = uint64_t(number / kPackets) * kPackets *
+                            SensorsPacket::kSamplesPerPacket * kSampleMcs;
+    const int64_t host_time = NowMcs();
+    for (int i = 0; i < SensorsPacket::kSamplesPerPacket; ++i) {
+      SensorsSample& sample = samples[i];
+      sample.mcs_time = repeat + SensorsPacket::GetDeviceTime(packet.data(), i);
+      sample.host_time = host_time;
+      SensorsPacket::DecodeSample(packet.data(), i, sample);
+    }
+    benchmark::DoNotOptimize(SensorsPacket::IsWorn(packet.data()));
+    ++number;
+  }
+
+  /*! Обработать следующий пакет */
+  void Step() {
+    SensorsSample samples[SensorsPacket::kSamplesPerPacket];
+    Decode(samples);
+    fusion.ProcessBatch(samples, SensorsPacket::kSamplesPerPacket);
+  }
+};
+
+
+/*! Выдать разобранные измерения записи для замеров отдельных шагов */
+std::vector<SensorsSample> DecodeSamples() {
+  SensorsPath path;
+  std::vector<SensorsSample> samples(
+      kPackets * SensorsPacket::kSamplesPerPacket);
+  for (int i = 0; i < kPackets; ++i) {
+    path.Decode(&samples[i * SensorsPacket::kSamplesPerPacket]);
+  }
+  return samples;
+}
+
+}  // namespace
+
+
+static void BM_Rotate(benchmark::State& state) {
+  const std::vector<SensorsSample> samples = DecodeSamples();
+  Rotation rotation;
+  size_t n = 0;
+  for (auto _ : state) {
+    const SensorsSample& s = samples[n++ % samples.size()];
+    rotation.Rotate(s.to_right, s.to_top, s.to_clockwork);
+  }
+}
+BENCHMARK(BM_Rotate);
+
+
+static void BM_CorrectTilt(benchmark::State& state) {
+  const std::vector<SensorsSample> samples = DecodeSamples();
+  Rotation rotation;
+  rotation.Rotate(10.0, 5.0, 3.0);
+  size_t n = 0;
+  for (auto _ : state) {
+    const SensorsSample& s = samples[n++ % samples.size()];
+    rotation.CorrectTilt(s.accel_right, s.accel_top, s.accel_forward, 0.001);
+  }
+}
+BENCHMARK(BM_CorrectTilt);
+
+
+static void BM_GetSummRotation(benchmark::State& state) {
+  Rotation rotation;
+  rotation.Rotate(10.0, 5.0, 3.0);
+  glm::mat4 rot_mat;
+  for (auto _ : state) {
+    rotation.GetSummRotation(rot_mat);
+    benchmark::DoNotOptimize(rot_mat);
+  }
+}
+BENCHMARK(BM_GetSummRotation);
+
+
+static void BM_OneEuroFilter(benchmark::State& state) {
+  const std::vector<SensorsSample> samples = DecodeSamples();
+  OneEuroFilter smoothing;
+  smoothing.SetParameters(1.0, 0.01, 1.0);
+  size_t n = 0;
+  for (auto _ : state) {
+    const SensorsSample& s = samples[n++ % samples.size()];
+    double velocity[3] = {
+        s.to_right * 1000.0, s.to_top * 1000.0, s.to_clockwork * 1000.0};
+    smoothing.Filter(velocity, kSampleMcs * 1.0e-6);
+    benchmark::DoNotOptimize(velocity);
+  }
+}
+BENCHMARK(BM_OneEuroFilter);
+
+
+/*! Разбор пакета сенсоров. В замер входит и чтение часов компьютера, как при
+приходе пакета */
+static void BM_PacketDecode(benchmark::State& state) {
+  SensorsPath path;
+  SensorsSample samples[SensorsPacket::kSamplesPerPacket];
+  for (auto _ : state) {
+    path.Decode(samples);
+    benchmark::DoNotOptimize(samples);
+  }
+  state.SetItemsProcessed(
+      state.iterations() * SensorsPacket::kSamplesPerPacket);
+}
+BENCHMARK(BM_PacketDecode);
+
+
+/*! Запрос положения на момент вывода кадра, как GetViewPointAt */
+static void BM_GetViewPointAt(benchmark::State& state) {
+  SensorsPath path;
+  for (int i = 0; i < 1000; ++i) {
+    path.Step();
+  }
+  glm::mat4 rot_mat;
+  for (auto _ : state) {
+    path.fusion.GetViewPointAt(NowMcs() + 15000, rot_mat);
+    benchmark::DoNotOptimize(rot_mat);
+  }
+}
+BENCHMARK(BM_GetViewPointAt);
+
+
+/*! Полная обработка пакета потоком сенсоров: разбор и расчёт положения.
+items_per_second - скорость обработки измерений */
+static void BM_SensorsPacket(benchmark::State& state) {
+  SensorsPath path;
+  for (auto _ : state) {
+    path.Step();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * SensorsPacket::kSamplesPerPacket);
+}
+BENCHMARK(BM_SensorsPacket);
+
+
+/*! Обработка пакета при одновременном чтении положения потоками отрисовки.
+Поток 0 - поток сенсоров, остальные читают положение, как GetViewPoint и
+GetViewPointAt. Измерения считает только поток 0, поэтому items_per_second -
+скорость обработки измерений под нагрузкой */
+static void BM_SensorsPacketContended(benchmark::State& state) {
+  static SensorsPath* path = nullptr;
+  if (state.thread_index() == 0) {
+    path = new SensorsPath();
+    for (int i = 0; i < 1000; ++i) {
+      path->Step();
+    }
+  }
+
+  // Потоки входят в цикл и выходят из него вместе (барьер), поэтому путь
+  // создаётся до чтения и удаляется после него
+  glm::mat4 rot_mat;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      path->Step();
+    } else if (state.thread_index() % 2 == 0) {
+      path->fusion.GetViewPoint(rot_mat);
+    } else {
+      path->fusion.GetViewPointAt(NowMcs() + 15000, rot_mat);
+    }
+    benchmark::DoNotOptimize(rot_mat);
+  }
+
+  if (state.thread_index() == 0) {
+    state.SetItemsProcessed(
+        state.iterations() * SensorsPacket::kSamplesPerPacket);
+    delete path;
+    path = nullptr;
+  }
+}
+BENCHMARK(BM_SensorsPacketContended)->ThreadRange(1, 4)->UseRealTime();
+
+
+BENCHMARK_MAIN();
@@ -271,3 +271,28 @@ TEST(TopRightClockView, Mathematics) {
 
   CheckTrack(t);
 }
+
+
+TEST(TiltCorrection, Mathematics) {
+  /* Повернём шлем вправо, затем добавим ложный наклон вверх (дрейф). При
+   * акселерометре, показывающем горизонтальное положение, наклон должен уйти,
+   * а поворот вправо - сохраниться */
+  const double kRightAngle = 30.0;
+  Rotation rt;
+  rt.Rotate(kRightAngle, 0.0, 0.0);
+  rt.Rotate(0.0, 10.0, 0.0);
+
+  for (int i = 0; i < 500; ++i) {
+    rt.CorrectTilt(0.0, 1.0, 0.0, 0.05);
+  }
+
+  glm::mat4 m;
+  rt.GetSummRotation(m);
+  auto view = m * glm::vec4(0.0, 0.0, 1.0, 1.0);
+  auto tip = m * glm::vec4(0.0, 1.0, 0.0, 1.0);
+
+  glm::vec3 expected_view(
+      sin(glm::radians(kRightAngle)), 0.0, cos(glm::radians(kRightAngle)));
+  EXPECT_LE(Distance(view, expected_view), kSuitableNearZeroLength);
+  EXPECT_LE(Distance(tip, glm::vec3(0.0, 1.0, 0.0)), kSuitableNearZeroLength);
+}